@@ -59,6 +59,13 @@ void unary(Fl_Window *group) {
   // Creates the determinant button.
   Fl_Button *determinant = new Fl_Button(261, 220, 40, 40, "#");
   setup_button(group, determinant);
+
+  // Creates the boundary box with label 'charpoly'.
+  Fl_Box *charpoly_info = new Fl_Box(401, 165, 85, 50, "charpoly");
+  setup_boundary_box(group, charpoly_info);
+  // Creates the characteristic polynomial button.
+  Fl_Button *charpoly = new Fl_Button(401, 170, 40, 40, "%");
+  setup_button(group, charpoly);
 }
 
 /**
@@ -82,6 +89,20 @@ void binary(Fl_Window *group) {
   // Creates the multiplication button.
   Fl_Button *mul = new Fl_Button(211, 90, 40, 40, "*");
   setup_button(group, mul);
+
+  // Creates the boundary box with label 'solve'.
+  Fl_Box *solve_info = new Fl_Box(261, 85, 140, 50, "solve");
+  setup_boundary_box(group, solve_info);
+  // Creates the solve button.
+  Fl_Button *solve = new Fl_Button(261, 90, 40, 40, "\\");
+  setup_button(group, solve);
+
+  // Creates the boundary box with label 'power'.
+  Fl_Box *power_info = new Fl_Box(401, 85, 85, 50, "power");
+  setup_boundary_box(group, power_info);
+  // Creates the power button.
+  Fl_Button *power = new Fl_Button(401, 90, 40, 40, "~");
+  setup_button(group, power);
 }
 
 /**
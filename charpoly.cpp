@@ -0,0 +1,161 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "charpoly.h"
+#include "operations.h"
+#include "pool.h"
+
+using namespace std;
+
+/**
+ * The number of fraction operations below which a step is not worth splitting
+ * between threads.
+ */
+#define PARALLEL_OPERATIONS 4096
+
+/**
+ * Calls body on ranges of the indices from begin to end, each of which takes
+ * the passed in number of operations. If there are enough of them, the ranges
+ * are processed by the shared pool at the same time.
+ */
+static void for_range(int begin, int end, int width, const function<void(int, int)> &body) {
+  int grain = max(1, PARALLEL_OPERATIONS / max(1, width));
+
+  if (end - begin <= grain) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+
+  pool_parallel_for(shared_pool(), begin, end, grain, body);
+}
+
+/**
+ * Returns the coefficients of the characteristic polynomial det(xI - A) of a
+ * square matrix as a row, from the leading coefficient 1 down to the constant
+ * term, which is (-1)^n times the determinant. Returns a null pointer if the
+ * matrix is not square.
+ *
+ * Berkowitz's algorithm builds the polynomial of every leading principal
+ * submatrix from that of the one before. With the leading k by k submatrix
+ * split into [M S; R a], the new polynomial is the product of the old one and
+ * the Toeplitz matrix whose first column is 1, -a, -RS, -RMS, -RM^2S and so
+ * on. It only adds and multiplies the elements, so integer matrices never
+ * produce fractions and the coefficients grow no more than the polynomial
+ * itself. The products with M and the polynomial products are split between
+ * threads for large matrices.
+ */
+Matrix* characteristic_polynomial(Matrix *a) {
+  int n = a->get_rows();
+
+  if (n != a->get_columns()) {
+    report_error("The matrices' dimensions do not match!");
+    return nullptr;
+  }
+
+  vector<Fraction> polynomial(1, Fraction (1));
+  vector<Fraction> toeplitz;
+  vector<Fraction> applied;
+  vector<Fraction> product;
+
+  for (int k = 1; k <= n; k++) {
+    int m = k - 1;
+    const Fraction *row = a->elements + m * n;
+
+    toeplitz.assign(k + 1, Fraction ());
+    toeplitz[0] = Fraction (1);
+    toeplitz[1] = -row[m];
+
+    // The powers of M applied to S are found one after another, each being M
+    // times the one before.
+    applied.resize(m);
+
+    for (int i = 0; i < m; i++) {
+      applied[i] = a->elements[i * n + m];
+    }
+
+    for (int j = 0; j < m; j++) {
+      Fraction dot;
+
+      for (int i = 0; i < m; i++) {
+        if (applied[i][0] != 0) {
+          dot += row[i] * applied[i];
+        }
+      }
+
+      toeplitz[j + 2] = -dot;
+
+      if (j + 1 == m) {
+        break;
+      }
+
+      product.assign(m, Fraction ());
+
+      for_range(0, m, m, [&](int from, int to) {
+        for (int i = from; i < to; i++) {
+          Fraction sum;
+
+          for (int l = 0; l < m; l++) {
+            if (applied[l][0] != 0) {
+              sum += a->elements[i * n + l] * applied[l];
+            }
+          }
+
+          product[i] = sum;
+        }
+      });
+
+      applied.swap(product);
+    }
+
+    // The new polynomial has one more coefficient than the old one and each
+    // of them is a sum over the lower triangular Toeplitz matrix.
+    product.assign(k + 1, Fraction ());
+
+    for_range(0, k + 1, k, [&](int from, int to) {
+      for (int i = from; i < to; i++) {
+        Fraction sum;
+
+        for (int j = 0; j <= min(i, k - 1); j++) {
+          if (polynomial[j][0] != 0) {
+            sum += toeplitz[i - j] * polynomial[j];
+          }
+        }
+
+        product[i] = sum;
+      }
+    });
+
+    polynomial.swap(product);
+  }
+
+  Matrix *result = new Matrix(1, n + 1);
+
+  for (int i = 0; i <= n; i++) {
+    result->elements[i] = polynomial[i];
+  }
+
+  return result;
+}
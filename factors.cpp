@@ -0,0 +1,252 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "factors.h"
+
+using namespace std;
+
+/**
+ * The states kept for the matrices by their ids. The store is never freed, as
+ * matrices may still be destroyed while the program exits.
+ */
+struct factor_store {
+  unordered_map<unsigned long, struct factor_state> states;
+  mutex lock;
+};
+
+static struct factor_store *store = new factor_store;
+
+/**
+ * Removes the state with the passed in id from the store and returns its
+ * inverse. The caller holds the lock and deletes the inverse after releasing
+ * it, since destroying a matrix takes the lock as well.
+ */
+static Matrix* erase_state(unsigned long id) {
+  unordered_map<unsigned long, struct factor_state>::iterator found = store->states.find(id);
+  Matrix *inverse = nullptr;
+
+  if (found != store->states.end()) {
+    inverse = found->second.inverse;
+    store->states.erase(found);
+  }
+
+  return inverse;
+}
+
+/**
+ * Returns the state kept for the current version of the passed in matrix or a
+ * null pointer if there is none. The caller holds the lock.
+ */
+static struct factor_state* current_state(Matrix *a) {
+  unordered_map<unsigned long, struct factor_state>::iterator found = store->states.find(a->id);
+
+  if (found == store->states.end() || found->second.version != a->version) {
+    return nullptr;
+  }
+
+  return &found->second;
+}
+
+/**
+ * Stores the determinant kept for the current version of the passed in matrix
+ * in determinant. Returns false if there is none.
+ */
+bool factors_determinant(Matrix *a, Fraction *determinant) {
+  lock_guard<mutex> guard(store->lock);
+
+  struct factor_state *state = current_state(a);
+
+  if (state == nullptr || !state->has_determinant) {
+    return false;
+  }
+
+  *determinant = state->determinant;
+
+  return true;
+}
+
+/**
+ * Returns a newly allocated copy of the inverse kept for the current version
+ * of the passed in matrix or a null pointer if there is none.
+ */
+Matrix* factors_inverse(Matrix *a) {
+  lock_guard<mutex> guard(store->lock);
+
+  struct factor_state *state = current_state(a);
+
+  if (state == nullptr || state->inverse == nullptr) {
+    return nullptr;
+  }
+
+  Matrix *inverse = new Matrix(a->get_rows(), a->get_columns());
+  *inverse = *state->inverse;
+
+  return inverse;
+}
+
+/**
+ * Returns the state of the current version of the passed in matrix, replacing
+ * an out of date one by an empty state. The caller holds the lock and deletes
+ * the returned old inverse after releasing it.
+ */
+static struct factor_state* fresh_state(Matrix *a, Matrix **old) {
+  struct factor_state *state = current_state(a);
+
+  *old = nullptr;
+
+  if (state == nullptr) {
+    *old = erase_state(a->id);
+    state = &store->states[a->id];
+    a->stored |= STORED_FACTORS;
+    *state = {a->version, nullptr, false, Fraction ()};
+  }
+
+  return state;
+}
+
+/**
+ * Keeps a copy of the inverse of the current version of the passed in matrix
+ * next to its determinant, if that is kept.
+ */
+void factors_record_inverse(Matrix *a, Matrix *inverse) {
+  Matrix *copy = new Matrix(a->get_rows(), a->get_columns());
+  Matrix *old;
+
+  *copy = *inverse;
+
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    struct factor_state *state = fresh_state(a, &old);
+
+    if (state->inverse != nullptr) {
+      old = state->inverse;
+    }
+
+    state->inverse = copy;
+  }
+
+  delete old;
+}
+
+/**
+ * Keeps the determinant of the current version of the passed in matrix next to
+ * its inverse, if that is kept.
+ */
+void factors_record_determinant(Matrix *a, const Fraction &determinant) {
+  Matrix *old;
+
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    struct factor_state *state = fresh_state(a, &old);
+
+    state->has_determinant = true;
+    state->determinant = determinant;
+  }
+
+  delete old;
+}
+
+/**
+ * Updates the state of a matrix whose element in the passed in row and column
+ * was just increased by delta, which increased its version by one. The change
+ * adds delta * e_row * e_column^T to the matrix, so by the matrix determinant
+ * lemma the determinant is multiplied by 1 + delta * B[column][row], where B is
+ * the inverse, and by the Sherman-Morrison formula the inverse becomes
+ * B - delta / (1 + delta * B[column][row]) * B[.][row] * B[column][.]. If the
+ * edit makes the matrix singular, the state is out of date or it has no
+ * inverse to update with, it is dropped.
+ */
+void factors_update(Matrix *a, int row, int column, const Fraction &delta) {
+  unique_lock<mutex> guard(store->lock);
+
+  unordered_map<unsigned long, struct factor_state>::iterator found = store->states.find(a->id);
+
+  if (found == store->states.end()) {
+    return;
+  }
+
+  struct factor_state &state = found->second;
+
+  if (state.version + 1 != a->version || state.inverse == nullptr) {
+    Matrix *old = erase_state(a->id);
+    guard.unlock();
+    delete old;
+    return;
+  }
+
+  int n = a->get_rows();
+  Fraction *b = state.inverse->elements;
+  Fraction denominator = Fraction (1) + delta * b[column * n + row];
+
+  if (denominator[0] == 0) {
+    Matrix *old = erase_state(a->id);
+    guard.unlock();
+    delete old;
+    return;
+  }
+
+  Fraction factor = delta / denominator;
+  vector<Fraction> u(n);
+  vector<Fraction> v(n);
+
+  for (int i = 0; i < n; i++) {
+    u[i] = b[i * n + row];
+    v[i] = b[column * n + i];
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (u[i][0] == 0) {
+      continue;
+    }
+
+    Fraction scaled = factor * u[i];
+
+    for (int j = 0; j < n; j++) {
+      b[i * n + j] -= scaled * v[j];
+    }
+  }
+
+  if (state.has_determinant) {
+    state.determinant *= denominator;
+  }
+
+  state.version = a->version;
+}
+
+/**
+ * Drops the state kept for the passed in matrix, which is being destroyed.
+ */
+void factors_forget(Matrix *a) {
+  Matrix *old;
+
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    old = erase_state(a->id);
+  }
+
+  delete old;
+}
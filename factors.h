@@ -0,0 +1,48 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __FACTORS_H_INCLUDED__
+#define __FACTORS_H_INCLUDED__
+
+#include "matrix.h"
+
+/**
+ * The inverse and determinant kept for a version of a saved matrix, each only
+ * once it has been asked for. The inverse is a null pointer until then. When a
+ * single element of the matrix is edited, the inverse and the determinant are
+ * updated in a number of operations quadratic in the size of the matrix
+ * instead of being recomputed, which needs the inverse.
+ */
+struct factor_state {
+  unsigned long version;
+  Matrix *inverse;
+  bool has_determinant;
+  Fraction determinant;
+};
+
+bool factors_determinant(Matrix *a, Fraction *determinant);
+Matrix* factors_inverse(Matrix *a);
+void factors_record_inverse(Matrix *a, Matrix *inverse);
+void factors_record_determinant(Matrix *a, const Fraction &determinant);
+void factors_update(Matrix *a, int row, int column, const Fraction &delta);
+void factors_forget(Matrix *a);
+
+#endif
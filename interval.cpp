@@ -0,0 +1,383 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+#include "interval.h"
+
+using namespace std;
+
+static double down(double x) {
+  return nextafter(x, -INFINITY);
+}
+
+static double up(double x) {
+  return nextafter(x, INFINITY);
+}
+
+/**
+ * Returns the narrowest interval around the passed in fraction.
+ */
+static struct interval enclose(const Fraction &f) {
+  double numerator = f[0];
+  double denominator = f[1];
+
+  if (denominator == 1.0) {
+    return {numerator, numerator};
+  }
+
+  double quotient = numerator / denominator;
+
+  return {down(quotient), up(quotient)};
+}
+
+static bool contains_zero(const struct interval &a) {
+  return a.low <= 0.0 && a.high >= 0.0;
+}
+
+static bool is_zero(const struct interval &a) {
+  return a.low == 0.0 && a.high == 0.0;
+}
+
+static struct interval add(const struct interval &a, const struct interval &b) {
+  return {down(a.low + b.low), up(a.high + b.high)};
+}
+
+static struct interval subtract(const struct interval &a, const struct interval &b) {
+  return {down(a.low - b.high), up(a.high - b.low)};
+}
+
+static struct interval multiply(const struct interval &a, const struct interval &b) {
+  if (is_zero(a) || is_zero(b)) {
+    return {0.0, 0.0};
+  }
+
+  double products[] = {a.low * b.low, a.low * b.high, a.high * b.low, a.high * b.high};
+
+  return {down(*min_element(products, products + 4)), up(*max_element(products, products + 4))};
+}
+
+/**
+ * Divides two intervals, the second of which must not contain zero.
+ */
+static struct interval divide(const struct interval &a, const struct interval &b) {
+  double quotients[] = {a.low / b.low, a.low / b.high, a.high / b.low, a.high / b.high};
+
+  return {down(*min_element(quotients, quotients + 4)), up(*max_element(quotients, quotients + 4))};
+}
+
+/**
+ * The element in row i and column j of the passed in matrix.
+ */
+static struct interval& at(struct interval_matrix &m, int i, int j) {
+  return m.elements[i * m.columns + j];
+}
+
+static void load(Matrix *a, struct interval_matrix *m) {
+  m->rows = a->get_rows();
+  m->columns = a->get_columns();
+  m->elements.resize(m->rows * m->columns);
+
+  for (int i = 0; i < m->rows * m->columns; i++) {
+    m->elements[i] = enclose(a->elements[i]);
+  }
+}
+
+/**
+ * Eliminates the first columns of the matrix, as many as it has rows, by
+ * Gauss-Jordan elimination, so that every column with a pivot ends up with a
+ * one on the pivot and exact zeros elsewhere. Only elements whose interval
+ * does not contain zero are taken as pivots, the largest one first. A column
+ * whose remaining elements are all exactly zero has no pivot. Returns false if
+ * it cannot be decided whether a column has a pivot, because some of its
+ * elements contain zero without being zero. Otherwise sets the rank and the
+ * determinant of the eliminated columns.
+ */
+static bool eliminate(struct interval_matrix &m, int width, bool reduce, int *rank, struct interval *det) {
+  int row = 0;
+
+  *det = {1.0, 1.0};
+
+  for (int c = 0; c < width && row < m.rows; c++) {
+    int pivot = -1;
+    bool undecided = false;
+
+    for (int r = row; r < m.rows; r++) {
+      const struct interval &candidate = at(m, r, c);
+
+      if (contains_zero(candidate)) {
+        undecided = undecided || !is_zero(candidate);
+      } else if (pivot < 0 || min(fabs(candidate.low), fabs(candidate.high)) >
+                                 min(fabs(at(m, pivot, c).low), fabs(at(m, pivot, c).high))) {
+        pivot = r;
+      }
+    }
+
+    if (pivot < 0) {
+      if (undecided) {
+        return false;
+      }
+
+      *det = {0.0, 0.0};
+      continue;
+    }
+
+    if (pivot != row) {
+      swap_ranges(m.elements.begin() + pivot * m.columns, m.elements.begin() + (pivot + 1) * m.columns,
+                  m.elements.begin() + row * m.columns);
+      *det = {-det->high, -det->low};
+    }
+
+    struct interval value = at(m, row, c);
+
+    *det = multiply(*det, value);
+
+    for (int j = c; j < m.columns; j++) {
+      at(m, row, j) = j == c ? interval {1.0, 1.0} : divide(at(m, row, j), value);
+    }
+
+    for (int r = reduce ? 0 : row + 1; r < m.rows; r++) {
+      struct interval factor = at(m, r, c);
+
+      if (r == row || is_zero(factor)) {
+        continue;
+      }
+
+      for (int j = c; j < m.columns; j++) {
+        at(m, r, j) = j == c ? interval {0.0, 0.0} : subtract(at(m, r, j), multiply(factor, at(m, row, j)));
+      }
+    }
+
+    row++;
+  }
+
+  *rank = row;
+
+  return true;
+}
+
+/**
+ * Carries out a single instruction in interval arithmetic. Returns false if
+ * the dimensions do not match, the matrix is singular or a decision cannot be
+ * made, leaving the instruction to the exact kernels.
+ */
+static bool run(struct plan *p, const struct instruction &ins, struct interval_matrix &a,
+                struct interval_matrix &b, struct interval_matrix *c) {
+  int rank;
+  struct interval det;
+
+  switch (ins.op) {
+    case OP_ADD:
+    case OP_SUBTRACT:
+      if (a.rows != b.rows || a.columns != b.columns) {
+        return false;
+      }
+
+      *c = a;
+
+      for (size_t i = 0; i < a.elements.size(); i++) {
+        c->elements[i] = ins.op == OP_ADD ? add(a.elements[i], b.elements[i])
+                                          : subtract(a.elements[i], b.elements[i]);
+      }
+      return true;
+    case OP_MULTIPLY:
+      if (a.columns != b.rows) {
+        return false;
+      }
+
+      c->rows = a.rows;
+      c->columns = b.columns;
+      c->elements.assign(a.rows * b.columns, interval {0.0, 0.0});
+
+      for (int i = 0; i < a.rows; i++) {
+        for (int k = 0; k < a.columns; k++) {
+          if (is_zero(at(a, i, k))) {
+            continue;
+          }
+
+          for (int j = 0; j < b.columns; j++) {
+            at(*c, i, j) = add(at(*c, i, j), multiply(at(a, i, k), at(b, k, j)));
+          }
+        }
+      }
+      return true;
+    case OP_SCALE: {
+      // The number is turned into a fraction first, as by the exact kernel.
+      struct interval number = enclose(Fraction (p->numbers[ins.argument]));
+
+      *c = a;
+
+      for (size_t i = 0; i < a.elements.size(); i++) {
+        c->elements[i] = multiply(a.elements[i], number);
+      }
+      return true;
+    }
+    case OP_TRANSPOSE:
+      c->rows = a.columns;
+      c->columns = a.rows;
+      c->elements.resize(a.elements.size());
+
+      for (int i = 0; i < a.rows; i++) {
+        for (int j = 0; j < a.columns; j++) {
+          at(*c, j, i) = at(a, i, j);
+        }
+      }
+      return true;
+    case OP_RREF:
+      *c = a;
+      return eliminate(*c, c->columns, true, &rank, &det);
+    case OP_DETERMINANT: {
+      if (a.rows != a.columns) {
+        return false;
+      }
+
+      // The operand may still be used by other instructions.
+      struct interval_matrix eliminated = a;
+
+      if (!eliminate(eliminated, a.columns, false, &rank, &det)) {
+        return false;
+      }
+
+      c->rows = 1;
+      c->columns = 1;
+      c->elements.assign(1, rank < a.rows ? interval {0.0, 0.0} : det);
+      return true;
+    }
+    case OP_INVERT:
+    case OP_SOLVE: {
+      int n = a.rows;
+      int k = ins.op == OP_INVERT ? n : b.columns;
+
+      if (a.rows != a.columns || (ins.op == OP_SOLVE && b.rows != n)) {
+        return false;
+      }
+
+      // The matrix is eliminated next to the identity or the right hand side,
+      // which turn into the inverse or the solution.
+      struct interval_matrix augmented = {n, n + k, vector<struct interval>((n + k) * n, interval {0.0, 0.0})};
+
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+          at(augmented, i, j) = at(a, i, j);
+        }
+
+        for (int j = 0; j < k; j++) {
+          at(augmented, i, n + j) = ins.op == OP_INVERT ? interval {i == j ? 1.0 : 0.0, i == j ? 1.0 : 0.0}
+                                                        : at(b, i, j);
+        }
+      }
+
+      if (!eliminate(augmented, n, true, &rank, &det) || rank < n) {
+        return false;
+      }
+
+      c->rows = n;
+      c->columns = k;
+      c->elements.resize(n * k);
+
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < k; j++) {
+          at(*c, i, j) = at(augmented, i, n + j);
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * Evaluates the plan in interval arithmetic, storing an enclosure of every
+ * element of its result in result. Returns false if some step cannot be
+ * carried out or decided with intervals, or an interval stops being finite,
+ * so that the plan has to be executed exactly instead. The user is not
+ * alerted, as the exact execution reports any error.
+ */
+bool interval_execute(struct matrix_list *l, struct plan *p, struct interval_matrix *result) {
+  vector<struct interval_matrix> values(p->code.size());
+
+  for (size_t pc = 0; pc < p->code.size(); pc++) {
+    const struct instruction &ins = p->code[pc];
+
+    if (ins.op == OP_LOAD) {
+      Matrix *operand = registry_resolve(l, ins.argument);
+
+      if (operand == nullptr) {
+        return false;
+      }
+
+      load(operand, &values[pc]);
+      continue;
+    }
+
+    struct interval_matrix none = {0, 0, vector<struct interval>()};
+
+    if (!run(p, ins, values[ins.left], ins.right >= 0 ? values[ins.right] : none, &values[pc])) {
+      return false;
+    }
+
+    for (size_t i = 0; i < values[pc].elements.size(); i++) {
+      if (!isfinite(values[pc].elements[i].low) || !isfinite(values[pc].elements[i].high)) {
+        return false;
+      }
+    }
+  }
+
+  *result = values[p->root];
+
+  return true;
+}
+
+/**
+ * Describes the enclosure of a matrix row by row, giving every element as its
+ * midpoint and the radius around it, or only its value if it is exact.
+ */
+string describe_enclosure(const struct interval_matrix &m) {
+  ostringstream os;
+
+  os << setprecision(10);
+
+  for (int i = 0; i < m.rows; i++) {
+    for (int j = 0; j < m.columns; j++) {
+      const struct interval &element = m.elements[i * m.columns + j];
+      double middle = element.low / 2.0 + element.high / 2.0;
+
+      if (j > 0) {
+        os << "   ";
+      }
+
+      os << middle;
+
+      if (element.low != element.high) {
+        os << " +/- " << setprecision(2) << max(up(element.high - middle), up(middle - element.low))
+           << setprecision(10);
+      }
+    }
+
+    os << "\n";
+  }
+
+  return os.str();
+}
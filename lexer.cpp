@@ -0,0 +1,213 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include "lexer.h"
+#include <FL/fl_ask.H>
+
+using namespace std;
+
+/**
+ * The precedence of every character indexed by the character itself, so that
+ * finding the precedence of a character is a single lookup.
+ */
+static precedence_value precedence_lookup[UCHAR_MAX + 1];
+
+/**
+ * Fills the lookup table from the table of operators on the first call.
+ */
+static void initialize_precedence_lookup(void) {
+  static bool initialized = false;
+
+  if (initialized) {
+    return;
+  }
+
+  struct precedence precedence_table[] =
+  { { '+', LOW },
+    { '-', LOW },
+    { '*', MEDIUM },
+    { '\\', MEDIUM },
+    { '~', HIGH },
+    { '|', HIGH },
+    { '^', HIGH },
+    { '&', HIGH },
+    { '#', HIGH },
+    { '%', HIGH },
+    { '(', VERY_HIGH },
+    { ')', VERY_VERY_HIGH } };
+
+  for (int i = 0; i <= UCHAR_MAX; i++) {
+    precedence_lookup[i] = NONE;
+  }
+
+  for (size_t i = 0; i < sizeof(precedence_table) / sizeof(precedence_table[0]); i++) {
+    precedence_lookup[(unsigned char) precedence_table[i].op] = precedence_table[i].prec;
+  }
+
+  initialized = true;
+}
+
+/**
+ * A function which returns the precedence of the passed in character.
+ */
+precedence_value find_precedence(char character) {
+  initialize_precedence_lookup();
+  return precedence_lookup[(unsigned char) character];
+}
+
+/**
+ * Checks whether the passed in character is an operator taking one argument.
+ * The power binds as tightly as those operators, but takes the exponent as its
+ * second argument.
+ */
+bool is_unary_operator(char character) {
+  return find_precedence(character) == HIGH && character != '~';
+}
+
+/**
+ * Splits the expression into tokens in a single pass and checks that it is
+ * valid along the way. A matrix name is a sequence of capital letters and a
+ * number is a sequence of at least one digit and at most one full stop, both followed by
+ * the terminating character. A number right after the power operator may be
+ * negative. Returns false and alerts the user if the expression is not valid.
+ */
+bool tokenize(const char *expression, vector<struct token> *tokens) {
+  const char *current = expression;
+  int arguments = 0;
+  int operators = 0;
+  int binary_operators = 0;
+  int depth = 0;
+
+  tokens->clear();
+
+  while (*current != '\0') {
+    struct token next;
+    next.position = current - expression;
+    next.op = *current;
+    next.prec = find_precedence(*current);
+    next.number = 0.0;
+
+    bool negative = *current == '-' && !tokens->empty() && tokens->back().type == TOKEN_OPERATOR
+                    && tokens->back().op == '~';
+
+    if (isupper((int)*current) || isdigit((int)*current) || *current == '.' || negative) {
+      // A matrix name or a number runs up to and including the terminating
+      // character.
+      bool is_number = !isupper((int)*current);
+      int full_stops = 0;
+      int digits = 0;
+
+      if (negative) {
+        current++;
+      }
+
+      while (is_number ? (isdigit((int)*current) || *current == '.') : isupper((int)*current)) {
+        if (*current == '.') {
+          full_stops++;
+        } else {
+          digits++;
+        }
+        current++;
+      }
+
+      if (*current != '\'' || full_stops > 1 || (is_number && digits == 0)) {
+        fl_alert("This is not a valid expression!");
+        return false;
+      }
+
+      current++;
+
+      next.type = is_number ? TOKEN_NUMBER : TOKEN_MATRIX;
+      next.length = current - expression - next.position;
+      next.op = '\0';
+      next.prec = NONE;
+
+      if (is_number) {
+        next.number = atof(expression + next.position);
+      }
+
+      arguments++;
+      tokens->push_back(next);
+      continue;
+    }
+
+    switch (next.prec) {
+      case LOW:
+      case MEDIUM:
+        operators++;
+        binary_operators++;
+        next.type = TOKEN_OPERATOR;
+        break;
+      case HIGH:
+        operators++;
+        if (!is_unary_operator(*current)) {
+          binary_operators++;
+        }
+        next.type = TOKEN_OPERATOR;
+        break;
+      case VERY_HIGH:
+        depth++;
+        next.type = TOKEN_OPEN;
+        break;
+      case VERY_VERY_HIGH:
+        if (--depth < 0) {
+          fl_alert("The number of brackets does not match!");
+          return false;
+        }
+        next.type = TOKEN_CLOSE;
+        break;
+      default:
+        if (isspace((int)*current)) {
+          current++;
+          continue;
+        }
+
+        fl_alert("This is not a valid expression!");
+        return false;
+    }
+
+    next.length = 1;
+    tokens->push_back(next);
+    current++;
+  }
+
+  if (depth != 0) {
+    fl_alert("The number of brackets does not match!");
+    return false;
+  }
+
+  if (operators == 0) {
+    fl_alert("You have no operators!");
+    return false;
+  }
+
+  // Every binary operator combines two arguments into one, so there has to be
+  // exactly one more argument than there are binary operators.
+  if (arguments != binary_operators + 1) {
+    fl_alert("This is not a valid expression!");
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,64 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __LEXER_H_INCLUDED__
+#define __LEXER_H_INCLUDED__
+
+#include <vector>
+
+/**
+ * Enumeration used to weigh the precedence on an operator.
+ */
+enum precedence_value {NONE = 0, LOW = 1, MEDIUM = 2, HIGH = 3, VERY_HIGH = 4, VERY_VERY_HIGH};
+
+/**
+ * A struct used to hold an operator and it's precedence.
+ */
+struct precedence
+{
+  char op;
+  precedence_value prec;
+};
+
+/**
+ * Enumeration of the kinds of tokens an expression consists of.
+ */
+enum token_type {TOKEN_MATRIX, TOKEN_NUMBER, TOKEN_OPERATOR, TOKEN_OPEN, TOKEN_CLOSE};
+
+/**
+ * A token of an expression. The position and the length locate the token in
+ * the expression, the precedence is only set for operators and brackets and
+ * the number is only set for numeric literals.
+ */
+struct token {
+  token_type type;
+  int position;
+  int length;
+  char op;
+  precedence_value prec;
+  double number;
+};
+
+precedence_value find_precedence(char character);
+bool is_unary_operator(char character);
+bool tokenize(const char *expression, std::vector<struct token> *tokens);
+
+#endif
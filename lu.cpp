@@ -0,0 +1,587 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "lu.h"
+#include "operations.h"
+#include "pool.h"
+
+using namespace std;
+
+/**
+ * The number of fraction operations below which a step of the elimination is
+ * carried out by the calling thread alone.
+ */
+#define PARALLEL_OPERATIONS 4096
+
+/**
+ * A 128-bit integer, wide enough for the product of two minors.
+ */
+__extension__ typedef __int128 wide;
+
+/**
+ * The factorisation kept for a version of a matrix.
+ */
+struct lu_entry {
+  unsigned long version;
+  shared_ptr<const struct lu_factors> factors;
+};
+
+/**
+ * The factorisations kept for the matrices by their ids. The store is never
+ * freed, as matrices may still be destroyed while the program exits.
+ */
+struct lu_store {
+  unordered_map<unsigned long, struct lu_entry> entries;
+  mutex lock;
+};
+
+static struct lu_store *store = new lu_store;
+
+/**
+ * The pivoting strategy used by new factorisations and the statistics
+ * gathered since they were last taken.
+ */
+static atomic<int> current_strategy(PIVOT_FIRST);
+static atomic<unsigned long> factorisations(0);
+static atomic<int> max_bits(0);
+
+/**
+ * Replaces the zeros among the passed in elements by a plain zero.
+ */
+static void clear_zeros(Fraction *elements, int size) {
+  for (int i = 0; i < size; i++) {
+    if (is_zero(elements[i])) {
+      elements[i] = Fraction ();
+    }
+  }
+}
+
+/**
+ * Checks whether every element of the passed in matrix is an integer.
+ */
+static bool is_integer_matrix(Matrix *a) {
+  for (int i = 0; i < a->get_rows() * a->get_columns(); i++) {
+    if (a->elements[i][1] != 1) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Returns the row to pivot on in column c among the rows from r onwards, which
+ * have not been used as pivots yet, or -1 if all of them are zero there.
+ * Markowitz pivoting minimises (row count - 1) * (column count - 1), the number
+ * of entries the step may fill in. Since the column is fixed by the echelon
+ * form, ties are broken by the smallest height.
+ */
+static int choose_pivot(const vector<Fraction> &m, int rows, int columns, int r, int c,
+                        enum pivot_strategy strategy) {
+  int best = -1;
+  long best_cost = 0;
+  int best_height = 0;
+  int column_count = 0;
+
+  if (strategy == PIVOT_MARKOWITZ) {
+    for (int p = r; p < rows; p++) {
+      if (!is_zero(m[p * columns + c])) {
+        column_count++;
+      }
+    }
+  }
+
+  for (int p = r; p < rows; p++) {
+    const Fraction &candidate = m[p * columns + c];
+
+    if (is_zero(candidate)) {
+      continue;
+    }
+
+    if (strategy == PIVOT_FIRST) {
+      return p;
+    }
+
+    long cost = 0;
+    int candidate_height = height(candidate);
+
+    if (strategy == PIVOT_SMALLEST_HEIGHT) {
+      cost = candidate_height;
+    } else {
+      int row_count = 0;
+
+      for (int j = c; j < columns; j++) {
+        if (!is_zero(m[p * columns + j])) {
+          row_count++;
+        }
+      }
+
+      cost = row_count;
+
+      if (strategy == PIVOT_MARKOWITZ) {
+        cost = (long)(row_count - 1) * (column_count - 1);
+      }
+    }
+
+    if (best < 0 || cost < best_cost
+        || (strategy == PIVOT_MARKOWITZ && cost == best_cost && candidate_height < best_height)) {
+      best = p;
+      best_cost = cost;
+      best_height = candidate_height;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Raises the passed in maximum to value if it is smaller.
+ */
+static void raise_max(atomic<int> &maximum, int value) {
+  int current = maximum;
+
+  while (value > current && !maximum.compare_exchange_weak(current, value)) {
+  }
+}
+
+/**
+ * Calls body on ranges of the rows (or columns) from begin to end, each of
+ * which takes the passed in number of operations to update. If there are
+ * enough of them, the ranges are processed by the shared pool at the same time.
+ */
+static void for_rows(int begin, int end, int width, const function<void(int, int)> &body) {
+  int grain = max(1, PARALLEL_OPERATIONS / max(1, width));
+
+  if (end - begin <= grain) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+
+  pool_parallel_for(shared_pool(), begin, end, grain, body);
+}
+
+/**
+ * Swaps two rows of a matrix stored row by row.
+ */
+static void swap_rows(vector<Fraction> &m, int columns, int first, int second) {
+  for (int j = 0; j < columns; j++) {
+    swap(m[first * columns + j], m[second * columns + j]);
+  }
+}
+
+/**
+ * Stores (pivot * element - below * other) / previous in result, where all of
+ * them are integers and Bareiss' algorithm guarantees the division to be
+ * exact. The products of two minors overflow an int long before the minors
+ * themselves do, so they are formed in 128 bits. Returns false if the quotient
+ * does not fit in a fraction.
+ */
+static bool bareiss_update(const Fraction &pivot, const Fraction &element, const Fraction &below,
+                           const Fraction &other, const Fraction &previous, Fraction *result) {
+  wide numerator = (wide) pivot[0] * element[0] - (wide) below[0] * other[0];
+  wide quotient = numerator / previous[0];
+
+  if (quotient < -INT_MAX || quotient > INT_MAX) {
+    return false;
+  }
+
+  *result = Fraction ((int) quotient, 1);
+
+  return true;
+}
+
+/**
+ * Factorises the passed in matrix into f. In the fraction-free case the
+ * working matrix holds minors of the matrix after every step, each row being
+ * divided exactly by the previous pivot, and the rows of U are recovered by
+ * dividing by that pivot once they are final. Returns false if a minor does not
+ * fit in a fraction, leaving f incomplete.
+ */
+static bool eliminate(Matrix *a, enum pivot_strategy strategy, bool fraction_free, struct lu_factors *f) {
+  int rows = a->get_rows();
+  int columns = a->get_columns();
+  vector<Fraction> m(a->elements, a->elements + rows * columns);
+  Fraction previous = Fraction (1);
+  Fraction product = Fraction (1);
+  bool negated = false;
+  int r = 0;
+
+  f->rows = rows;
+  f->columns = columns;
+  f->lu.assign(rows * columns, Fraction ());
+  f->permutation.clear();
+  f->pivots.clear();
+  f->fraction_free = fraction_free;
+  f->strategy = strategy;
+
+  atomic<int> step_bits(0);
+  atomic<bool> overflowed(false);
+
+  for (int i = 0; i < rows * columns; i++) {
+    raise_max(step_bits, height(m[i]));
+  }
+
+  for (int i = 0; i < rows; i++) {
+    f->permutation.push_back(i);
+  }
+
+  for (int c = 0; c < columns && r < rows; c++) {
+    // Find a row with a non-zero element in column c to act as the pivot.
+    int p = choose_pivot(m, rows, columns, r, c, strategy);
+
+    if (p < 0) {
+      continue;
+    }
+
+    // Swapping two rows changes the sign of the determinant.
+    if (p != r) {
+      swap_rows(m, columns, p, r);
+      swap_rows(f->lu, columns, p, r);
+      swap(f->permutation[p], f->permutation[r]);
+      negated = !negated;
+    }
+
+    Fraction pivot = m[r * columns + c];
+
+    f->pivots.push_back(c);
+
+    for (int j = c; j < columns; j++) {
+      f->lu[r * columns + j] = f->fraction_free ? m[r * columns + j] / previous : m[r * columns + j];
+    }
+
+    product *= f->lu[r * columns + c];
+
+    // The rows below the pivot are updated independently of each other, so
+    // they are split between threads while the pivot row is only read.
+    // Rows with a zero multiplier only need scaling in the fraction-free
+    // case and are left alone otherwise.
+    for_rows(r + 1, rows, columns - c, [&](int from, int to) {
+      int bits = 0;
+
+      for (int i = from; i < to; i++) {
+        Fraction below = m[i * columns + c];
+
+        if (is_zero(below)) {
+          if (f->fraction_free) {
+            for (int j = c + 1; j < columns; j++) {
+              if (!bareiss_update(pivot, m[i * columns + j], below, m[r * columns + j], previous, &m[i * columns + j])) {
+                overflowed = true;
+              }
+              bits = max(bits, height(m[i * columns + j]));
+            }
+          }
+          continue;
+        }
+
+        f->lu[i * columns + c] = below / pivot;
+
+        if (f->fraction_free) {
+          for (int j = c + 1; j < columns; j++) {
+            if (!bareiss_update(pivot, m[i * columns + j], below, m[r * columns + j], previous, &m[i * columns + j])) {
+              overflowed = true;
+            }
+            bits = max(bits, height(m[i * columns + j]));
+          }
+        } else {
+          Fraction factor = f->lu[i * columns + c];
+
+          for (int j = c + 1; j < columns; j++) {
+            m[i * columns + j] -= factor * m[r * columns + j];
+            bits = max(bits, height(m[i * columns + j]));
+          }
+        }
+
+        m[i * columns + c] = Fraction ();
+      }
+
+      raise_max(step_bits, bits);
+    });
+
+    if (overflowed) {
+      return false;
+    }
+
+    if (f->fraction_free) {
+      previous = pivot;
+    }
+
+    r++;
+  }
+
+  f->rank = r;
+  f->max_bits = step_bits;
+
+  clear_zeros(f->lu.data(), rows * columns);
+
+  // The last pivot of Bareiss' algorithm is the determinant itself.
+  if (rows != columns || r < rows) {
+    f->determinant = Fraction ();
+  } else {
+    f->determinant = f->fraction_free ? previous : product;
+
+    if (negated) {
+      f->determinant = -f->determinant;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Factorises the passed in matrix. Matrices with only integer elements are
+ * factorised without fractions, unless one of their minors is too large for a
+ * fraction, in which case they are factorised like any other matrix.
+ */
+static struct lu_factors* factorise(Matrix *a, enum pivot_strategy strategy) {
+  struct lu_factors *f = new lu_factors;
+
+  if (!is_integer_matrix(a) || !eliminate(a, strategy, true, f)) {
+    eliminate(a, strategy, false, f);
+  }
+
+  factorisations++;
+  raise_max(max_bits, f->max_bits);
+
+  return f;
+}
+
+/**
+ * Sets the pivoting strategy used by the factorisations from now on.
+ */
+void lu_set_strategy(enum pivot_strategy new_strategy) {
+  current_strategy = new_strategy;
+}
+
+/**
+ * Returns the pivoting strategy used by new factorisations.
+ */
+enum pivot_strategy lu_get_strategy(void) {
+  return (enum pivot_strategy) current_strategy.load();
+}
+
+/**
+ * Returns the name of the passed in pivoting strategy as shown to the user.
+ */
+const char* pivot_strategy_name(enum pivot_strategy strategy) {
+  switch (strategy) {
+    case PIVOT_SMALLEST_HEIGHT:
+      return "smallest height";
+    case PIVOT_SPARSEST_ROW:
+      return "sparsest row";
+    case PIVOT_MARKOWITZ:
+      return "Markowitz";
+    default:
+      return "first non-zero";
+  }
+}
+
+/**
+ * Returns the statistics gathered since they were last taken and starts
+ * gathering them anew.
+ */
+struct lu_statistics lu_take_statistics(void) {
+  struct lu_statistics statistics;
+
+  statistics.factorisations = factorisations.exchange(0);
+  statistics.max_bits = max_bits.exchange(0);
+
+  return statistics;
+}
+
+/**
+ * Returns the factorisation of the current version of the passed in matrix,
+ * computing it only if it has not been kept already for the current pivoting
+ * strategy.
+ */
+shared_ptr<const struct lu_factors> lu_factorise(Matrix *a) {
+  enum pivot_strategy current = lu_get_strategy();
+
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    unordered_map<unsigned long, struct lu_entry>::iterator found = store->entries.find(a->id);
+
+    if (found != store->entries.end() && found->second.version == a->version
+        && found->second.factors->strategy == current) {
+      return found->second.factors;
+    }
+  }
+
+  shared_ptr<const struct lu_factors> factors(factorise(a, current));
+
+  lock_guard<mutex> guard(store->lock);
+
+  store->entries[a->id] = {a->version, factors};
+  a->stored |= STORED_LU;
+
+  return factors;
+}
+
+/**
+ * Drops the factorisation kept for the passed in matrix, which is being
+ * destroyed.
+ */
+void lu_forget(Matrix *a) {
+  shared_ptr<const struct lu_factors> old;
+
+  lock_guard<mutex> guard(store->lock);
+
+  unordered_map<unsigned long, struct lu_entry>::iterator found = store->entries.find(a->id);
+
+  if (found != store->entries.end()) {
+    old = std::move(found->second.factors);
+    store->entries.erase(found);
+  }
+}
+
+/**
+ * Returns the solution X of AX = B, where A is the factorised matrix, by
+ * forward and back substitution. Returns a null pointer if A is not square
+ * and invertible or the number of rows of B does not match.
+ */
+Matrix* lu_solve(const struct lu_factors *f, Matrix *b) {
+  int n = f->rows;
+
+  if (f->rows != f->columns || f->rank < n || b->get_rows() != n) {
+    return nullptr;
+  }
+
+  int k = b->get_columns();
+  const Fraction *lu = f->lu.data();
+  Matrix *x = new Matrix(n, k);
+
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < k; j++) {
+      x->elements[i * k + j] = b->elements[f->permutation[i] * k + j];
+    }
+  }
+
+  // The columns of B are solved for independently, so they are split between
+  // threads. For each of them LY = PB is solved first and then UX = Y.
+  for_rows(0, k, n * n, [&](int from, int to) {
+    Fraction *e = x->elements;
+
+    for (int i = 0; i < n; i++) {
+      for (int q = 0; q < i; q++) {
+        if (is_zero(lu[i * n + q])) {
+          continue;
+        }
+
+        for (int j = from; j < to; j++) {
+          e[i * k + j] -= lu[i * n + q] * e[q * k + j];
+        }
+      }
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+      for (int q = i + 1; q < n; q++) {
+        if (is_zero(lu[i * n + q])) {
+          continue;
+        }
+
+        for (int j = from; j < to; j++) {
+          e[i * k + j] -= lu[i * n + q] * e[q * k + j];
+        }
+      }
+
+      for (int j = from; j < to; j++) {
+        e[i * k + j] /= lu[i * n + i];
+      }
+    }
+  });
+
+  clear_zeros(x->elements, n * k);
+
+  return x;
+}
+
+/**
+ * Returns the inverse of the factorised matrix or a null pointer if it is not
+ * square and invertible.
+ */
+Matrix* lu_inverse(const struct lu_factors *f) {
+  Matrix *identity = new Matrix(f->rows, f->rows);
+
+  for (int i = 0; i < f->rows; i++) {
+    identity->elements[i * f->rows + i] = Fraction (1);
+  }
+
+  Matrix *inverse = lu_solve(f, identity);
+
+  delete identity;
+
+  return inverse;
+}
+
+/**
+ * Returns the reduced row echelon form of the factorised matrix. Since L is
+ * invertible, the matrix and U share their row space and so their reduced row
+ * echelon form, which is found by scaling the pivots of U to one and clearing
+ * the columns above them, starting from the last one.
+ */
+Matrix* lu_reduced_row_echelon_form(const struct lu_factors *f) {
+  int columns = f->columns;
+  Matrix *c = new Matrix(f->rows, columns);
+  Fraction *e = c->elements;
+
+  for (int i = 0; i < f->rank; i++) {
+    for (int j = f->pivots[i]; j < columns; j++) {
+      e[i * columns + j] = f->lu[i * columns + j];
+    }
+  }
+
+  for (int k = f->rank - 1; k >= 0; k--) {
+    int pivot = f->pivots[k];
+    Fraction scale = e[k * columns + pivot];
+
+    for (int j = pivot; j < columns; j++) {
+      e[k * columns + j] /= scale;
+    }
+
+    for_rows(0, k, columns - pivot, [&](int from, int to) {
+      for (int i = from; i < to; i++) {
+        Fraction factor = e[i * columns + pivot];
+
+        if (is_zero(factor)) {
+          continue;
+        }
+
+        for (int j = pivot; j < columns; j++) {
+          e[i * columns + j] -= factor * e[k * columns + j];
+        }
+      }
+    });
+  }
+
+  // Zeros left by the subtractions are replaced by a plain zero.
+  clear_zeros(e, f->rows * columns);
+
+  return c;
+}
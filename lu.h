@@ -0,0 +1,79 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __LU_H_INCLUDED__
+#define __LU_H_INCLUDED__
+
+#include <memory>
+#include <vector>
+#include "matrix.h"
+
+/**
+ * Enumeration of the ways a pivot is chosen among the rows with a non-zero
+ * element in the column being eliminated. The first non-zero element is the
+ * cheapest choice, while the others try to keep the numerators and
+ * denominators of the following steps small.
+ */
+enum pivot_strategy {PIVOT_FIRST, PIVOT_SMALLEST_HEIGHT, PIVOT_SPARSEST_ROW, PIVOT_MARKOWITZ};
+
+/**
+ * The number of factorisations carried out and the largest bit size of a
+ * numerator or denominator any of them reached.
+ */
+struct lu_statistics {
+  unsigned long factorisations;
+  int max_bits;
+};
+
+/**
+ * The factorisation PA = LU of a matrix A, where P permutes the rows, L is
+ * unit lower triangular and U is in row echelon form. Both are stored in lu:
+ * row k of U holds its pivot in column pivots[k] and the multipliers of L used
+ * to eliminate that column are stored below the pivot, where U is zero. Row i
+ * of the factorisation is row permutation[i] of the matrix. Matrices with only
+ * integer elements are factorised without fractions in the intermediate steps
+ * (Bareiss' algorithm), unless one of their minors does not fit in a fraction,
+ * in which case fraction_free is false.
+ */
+struct lu_factors {
+  int rows;
+  int columns;
+  std::vector<Fraction> lu;
+  std::vector<int> permutation;
+  std::vector<int> pivots;
+  int rank;
+  Fraction determinant;
+  bool fraction_free;
+  enum pivot_strategy strategy;
+  int max_bits;
+};
+
+void lu_set_strategy(enum pivot_strategy strategy);
+enum pivot_strategy lu_get_strategy(void);
+const char* pivot_strategy_name(enum pivot_strategy strategy);
+struct lu_statistics lu_take_statistics(void);
+std::shared_ptr<const struct lu_factors> lu_factorise(Matrix *a);
+void lu_forget(Matrix *a);
+Matrix* lu_solve(const struct lu_factors *f, Matrix *b);
+Matrix* lu_inverse(const struct lu_factors *f);
+Matrix* lu_reduced_row_echelon_form(const struct lu_factors *f);
+
+#endif
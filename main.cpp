@@ -20,16 +20,27 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <string>
 #include "buttons.h"
+#include "interval.h"
+#include "lu.h"
 #include "main.h"
 #include "matrix.h"
+#include "memo_cache.h"
 #include "operations.h"
 #include "parser.h"
+#include "plan_cache.h"
+#include "planner.h"
+#include "pool.h"
+#include "solver.h"
+#include "verify.h"
 #include <FL/Fl.H>
 #include <FL/fl_ask.H>
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Button.H>
 #include <FL/Fl_Check_Button.H>
+#include <FL/Fl_Choice.H>
 #include <FL/Fl_Group.H>
 #include <FL/Fl_Int_Input.H>
 #include <FL/Fl_Return_Button.H>
@@ -42,6 +53,8 @@ using namespace std;
  */
 struct matrix_list l;
 list_iter iter;
+struct plan_cache plans;
+struct memo_cache results;
 
 Fl_Window *matrix_window;
 Fl_Window *edit_window = new Fl_Window(80, 380, "Edit Menu");
@@ -117,6 +130,45 @@ void initialize_calculator(void) {
   preview->shortcut(FL_CTRL + 'p');
   preview->set();
 
+  // Creates the interval checkbox.
+  Fl_Check_Button *interval = new Fl_Check_Button(120, 40, 40, 40, "&interval");
+  interval->shortcut(FL_CTRL + 'i');
+
+  // Creates the explain checkbox.
+  Fl_Check_Button *explain = new Fl_Check_Button(275, 40, 40, 40, "e&xplain");
+  explain->shortcut(FL_CTRL + 'x');
+
+  // Creates the verify checkbox.
+  Fl_Check_Button *verify = new Fl_Check_Button(361, 265, 40, 25, "ve&rify");
+  verify->shortcut(FL_CTRL + 'r');
+  verify->callback(verify_cb);
+
+  // Creates the choice of the pivoting strategy used by the eliminations.
+  Fl_Choice *pivoting = new Fl_Choice(361, 310, 120, 25, "pivoting");
+  pivoting->align(FL_ALIGN_TOP);
+  for (int i = PIVOT_FIRST; i <= PIVOT_MARKOWITZ; i++) {
+    pivoting->add(pivot_strategy_name((enum pivot_strategy) i));
+  }
+  pivoting->value(lu_get_strategy());
+  pivoting->callback(pivoting_cb);
+
+  // Creates the choice of the method used by the solve operator, listing the
+  // exact methods followed by every iterative method with every
+  // preconditioner.
+  Fl_Choice *solver = new Fl_Choice(361, 360, 120, 25, "solver");
+  solver->align(FL_ALIGN_TOP);
+  solver->add(solve_method_name(SOLVE_DIRECT));
+  solver->add(solve_method_name(SOLVE_REFINED));
+  for (int i = SOLVE_CG; i <= SOLVE_GMRES; i++) {
+    for (int j = PRECONDITION_NONE; j <= PRECONDITION_ILU0; j++) {
+      string name = string(solve_method_name((enum solve_method) i)) + " + "
+                    + preconditioner_name((enum preconditioner) j);
+      solver->add(name.c_str());
+    }
+  }
+  solver->value(0);
+  solver->callback(solver_cb);
+
   // Creates the backspace button.
   Fl_Button *backspace = new Fl_Button(361, 390, 100, 40, "&backspace");
   backspace->shortcut(FL_CTRL + 'b');
@@ -126,9 +178,11 @@ void initialize_calculator(void) {
   // Creates the calculate button.
   Fl_Button *calculate = new Fl_Button(361, 440, 100, 40, "ca&lculate");
   calculate->shortcut(FL_CTRL + 'l');
-  Fl_Widget **args = new Fl_Widget* [2];
+  Fl_Widget **args = new Fl_Widget* [4];
   args[0] = save;
   args[1] = preview;
+  args[2] = explain;
+  args[3] = interval;
   calculate->callback(calculate_cb, args);
   calculate->box(FL_PLASTIC_UP_BOX);
 
@@ -285,6 +339,12 @@ void calculator_close_cb(Fl_Widget *widget, void*) {
 
   clear_windows();
 
+  plan_cache_clear(&plans);
+
+  memo_cache_clear(&results);
+
+  shared_pool_destroy();
+
   list_destroy(&l);
 
   window->hide();
@@ -367,6 +427,36 @@ void delete_checked_cb(Fl_Widget *widget, void *) {
   redraw_windows();
 }
 
+/**
+ * The pivoting_cb sets the pivoting strategy to the one chosen by the user.
+ */
+void pivoting_cb(Fl_Widget *widget, void *) {
+  lu_set_strategy((enum pivot_strategy) ((Fl_Choice *) widget)->value());
+}
+
+/**
+ * The solver_cb sets the solve method and preconditioner to the ones chosen by
+ * the user, in the order they are listed by initialize_calculator.
+ */
+void solver_cb(Fl_Widget *widget, void *) {
+  int chosen = ((Fl_Choice *) widget)->value();
+
+  if (chosen <= SOLVE_REFINED) {
+    solve_set_method((enum solve_method) chosen, PRECONDITION_NONE);
+  } else {
+    solve_set_method((enum solve_method) (SOLVE_CG + (chosen - SOLVE_CG) / 3),
+                     (enum preconditioner) ((chosen - SOLVE_CG) % 3));
+  }
+}
+
+/**
+ * The verify_cb turns the verification of products, inverses and solutions on
+ * or off.
+ */
+void verify_cb(Fl_Widget *widget, void *) {
+  verify_set_enabled((int) ((Fl_Check_Button *) widget)->value());
+}
+
 /**
  * The backspace_cb deletes the rightmost character in the input line.
  * If there are no characters it does nothing.
@@ -398,27 +488,113 @@ void calculate_cb(Fl_Widget *widget, void *args) {
 
   int save_value = (int) ((Fl_Check_Button *) widgets[0])->value();
   int preview_value = (int) ((Fl_Check_Button *) widgets[1])->value();
+  int explain_value = (int) ((Fl_Check_Button *) widgets[2])->value();
+  int interval_value = (int) ((Fl_Check_Button *) widgets[3])->value();
+
+  // Looks up the plan of the expression in the cache. The expression only has
+  // to be validated, converted to postfix notation and compiled if it is not
+  // there.
+  string normalised = normalise_expression(expression);
+  struct plan *cached = plan_cache_find(&plans, &l, normalised);
+
+  if (cached == nullptr) {
+    // Splits the expression into tokens and checks that it is valid. If it
+    // is not, then the function returns.
+    vector<struct token> tokens;
+
+    if (!tokenize(expression, &tokens)) {
+      return;
+    }
 
-  // Checks if the expression is valid. If it is not, then the function returns.
-  if (!correct_expression(expression)) {
-    fl_alert("This is not a valid expression!");
-    return;
+    // Changes the tokens from infix notation to postfix notation.
+    vector<struct token> postfix;
+    infix_to_postfix(tokens, &postfix);
+
+    // Compiles the postfix expression into a plan. If there were problems with
+    // the compilation, then the function returns.
+    struct plan compiled;
+
+    if (!compile_plan(&l, expression, postfix, &compiled)) {
+      return;
+    }
+
+    // Rearranges the plan into a cheaper equivalent one.
+    optimise_plan(&l, &compiled);
+
+    cached = plan_cache_insert(&plans, normalised, &compiled);
   }
 
-  // Changes the expression from infix notation to postfix notation.
-  char *postfix = infix_to_postfix(expression);
+  // If the interval checkbox is ticked and the result is only previewed, then
+  // an enclosure of it is found in interval arithmetic and shown instead. The
+  // exact result is only calculated if the intervals cannot decide a step.
+  bool undecided = false;
 
-  // If there were problems with the postfix conversion, then the function
-  // returns.
-  if (postfix == nullptr) {
-    return;
+  if (interval_value && preview_value && !save_value) {
+    struct interval_matrix enclosure;
+
+    if (interval_execute(&l, cached, &enclosure)) {
+      fl_message("%s", describe_enclosure(enclosure).c_str());
+      return;
+    }
+
+    undecided = true;
   }
 
-  // Calls the calculate function and assigns the result to a new matrix.
-  Matrix *calculated = calculate(&l, iter, postfix);
+  lu_take_statistics();
+  solve_take_statistics();
+  verify_take_statistics();
+
+  Matrix *calculated = execute_plan(&l, cached, &results);
+
+  // If the explain checkbox is ticked, then the plan is shown alongside the
+  // estimated and actual time of each step and the growth of the coefficients
+  // in the eliminations which were carried out.
+  if (explain_value) {
+    string explanation = explain_plan(&l, cached);
+    struct lu_statistics statistics = lu_take_statistics();
+
+    if (statistics.factorisations > 0) {
+      ostringstream os;
+      os << "\n" << statistics.factorisations << " elimination(s) with "
+         << pivot_strategy_name(lu_get_strategy()) << " pivoting, largest coefficient "
+         << statistics.max_bits << " bits";
+      explanation += os.str();
+    }
+
+    struct solve_statistics solves = solve_take_statistics();
+
+    if (solves.solves > 0 && solve_get_method() == SOLVE_REFINED) {
+      ostringstream os;
+      os << "\n" << solves.solves << " refined solve(s), " << solves.iterations
+         << " refinement step(s), " << solves.fallbacks << " solved exactly instead";
+      explanation += os.str();
+    } else if (solves.solves > 0) {
+      ostringstream os;
+      os << "\n" << solves.solves << " iterative solve(s) with "
+         << solve_method_name(solve_get_method()) << " and "
+         << preconditioner_name(solve_get_preconditioner()) << " preconditioning, "
+         << solves.iterations << " iteration(s), relative residual " << solves.residual;
+      explanation += os.str();
+    }
+
+    struct verify_statistics verified = verify_take_statistics();
+
+    if (verified.checks > 0) {
+      ostringstream os;
+      os << "\n" << verified.checks << " result(s) verified, " << verified.failures << " failed";
+      explanation += os.str();
+    }
 
-  // Return the resources allocated for postfix as it is no longer needed.
-  delete[] postfix;
+    ostringstream cache_counts;
+    cache_counts << "\nPlan cache: " << plans.hits << " hit(s), " << plans.misses << " miss(es)";
+    explanation += cache_counts.str();
+
+    if (undecided) {
+      explanation += "\nThe interval arithmetic could not decide a step, so the result is exact";
+    }
+
+    fl_message("%s", explanation.c_str());
+  }
 
   // If there were problems with the calculations, then the function returns.
   if (calculated == nullptr) {
@@ -430,10 +606,12 @@ void calculate_cb(Fl_Widget *widget, void *args) {
     enter(calculated, 1);
   }
 
-  // If the save checkbox is unticked, then the calculated matrix is deleted
-  // from the matrix list.
-  if (!save_value) {
-    list_delete(&l, list_end(&l));
+  // If the save checkbox is ticked, then the calculated matrix is inserted in
+  // the matrix list, else it is deleted.
+  if (save_value) {
+    list_insert(&l, iter, calculated);
+  } else {
+    delete calculated;
   }
 
   redraw_windows();
@@ -42,6 +42,9 @@ void display_matrix_cb(Fl_Widget *widget, void *iter);
 void toggle_cb(Fl_Widget *widget, void *window_ptr);
 void uncheck_cb(Fl_Widget *widget, void *button);
 void delete_checked_cb(Fl_Widget *widget, void *data);
+void pivoting_cb(Fl_Widget *widget, void *);
+void solver_cb(Fl_Widget *widget, void *);
+void verify_cb(Fl_Widget *widget, void *);
 void backspace_cb(Fl_Widget *widget, void *);
 void calculate_cb(Fl_Widget *widget, void *args);
 void initialize_matrix_cb(Fl_Widget *widget, void *);
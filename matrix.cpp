@@ -19,10 +19,15 @@
  * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
  */
 
+#include <atomic>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include "factors.h"
+#include "lu.h"
 #include "matrix.h"
+#include "sparse.h"
+#include "structure.h"
 #include <FL/Fl.H>
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Button.H>
@@ -35,11 +40,18 @@
 
 using namespace std;
 
+/**
+ * The id given to the next matrix which is created. Results may be created by
+ * the workers of a parallel execution, so the counter is atomic.
+ */
+static atomic<unsigned long> next_id(0);
+
 /**
  * The constructor for the Matrix class. Allocates all the elements of the
- * matrix.
+ * matrix and gives it a unique id. The version is increased every time the
+ * elements change.
  */
-Matrix::Matrix (int x, int y) : rows(x), columns(y) {
+Matrix::Matrix (int x, int y) : rows(x), columns(y), id(next_id++), version(0), stored(0) {
   elements = new Fraction [rows * columns];
   for (int i = 0; i < rows * columns; i++) {
     elements[i] = Fraction ();
@@ -47,9 +59,26 @@ Matrix::Matrix (int x, int y) : rows(x), columns(y) {
 }
 
 /**
- * The destructor for the Matrix class. Returns the allocated resources.
+ * The destructor for the Matrix class. Returns the allocated resources,
+ * including whatever the stores it got an entry in keep for it.
  */
 Matrix::~Matrix () {
+  if (stored & STORED_FACTORS) {
+    factors_forget(this);
+  }
+
+  if (stored & STORED_LU) {
+    lu_forget(this);
+  }
+
+  if (stored & STORED_SPARSE) {
+    sparse_forget(this);
+  }
+
+  if (stored & STORED_STRUCTURE) {
+    structure_forget(this);
+  }
+
   delete[] elements;
 }
 
@@ -148,6 +177,8 @@ void Matrix::operator= (Matrix& other) {
   for (int i = 0; i < this->get_rows() * this->get_columns(); i++) {
     this->elements[i] = other.elements[i];
   }
+
+  this->version++;
 }
 
 /**
@@ -158,6 +189,8 @@ Matrix& Matrix::operator= (Matrix&& other) {
     this->elements[i] = other.elements[i];
   }
 
+  this->version++;
+
   return *this;
 }
 
@@ -201,6 +234,9 @@ void enter(Matrix *a, int preview_flag) {
 
     preview_group->end();
 
+    // The inputs find the matrix they edit through their group.
+    preview_group->user_data(a);
+
     // Creates the inputs and assigns them the value of the corresponding
     // matrix element. The element is then added to the group.
     for (int i = 0; i < rows; i++) {
@@ -261,9 +297,18 @@ void close_cb(Fl_Widget *widget, void *) {
 
 /**
  * Used to update the value of a matrix element when the user changes the value
- * in the corresponding input line.
+ * in the corresponding input line. The version of the matrix is increased, so
+ * that results computed from its old elements are no longer used, and a kept
+ * inverse and determinant are updated to the new element.
  */
 void change_value_cb(Fl_Widget *widget, void *entry) {
   Fraction *fraction = (Fraction *) entry;
+  Matrix *matrix = (Matrix *) widget->parent()->user_data();
+  Fraction old_value = *fraction;
+  int index = fraction - matrix->elements;
+
   *fraction = Fraction (((Fl_Float_Input *) widget)->value());
+  matrix->version++;
+
+  factors_update(matrix, index / matrix->get_columns(), index % matrix->get_columns(), *fraction - old_value);
 }
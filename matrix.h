@@ -22,15 +22,30 @@
 #ifndef __MATRIX_H_INCLUDED__
 #define __MATRIX_H_INCLUDED__
 
+#include <atomic>
 #include "Fraction.h"
 #include <FL/Fl_Widget.H>
 
+/**
+ * The stores which may keep something for a matrix. A matrix records each store
+ * it got an entry in, so that only those are visited when it is destroyed.
+ */
+enum stored_flag {
+  STORED_FACTORS = 1,
+  STORED_LU = 2,
+  STORED_SPARSE = 4,
+  STORED_STRUCTURE = 8
+};
+
 class Matrix {
 private:
   int rows;
   int columns;
 public:
   Fraction *elements;
+  unsigned long id;
+  unsigned long version;
+  std::atomic<unsigned> stored;
   Matrix(int, int);
   ~Matrix();
   int get_rows(void);
@@ -49,6 +49,11 @@ void list_init(struct matrix_list *l) {
   l->header->next = l->footer;
   l->footer->prev = l->header;
   l->size = 0;
+  l->entries.clear();
+  l->free_slots.clear();
+  l->symbols.clear();
+  l->symbol_ids.clear();
+  l->bound.clear();
 }
 
 /**
@@ -81,6 +86,8 @@ void list_insert(struct matrix_list *l, list_iter iter, Matrix *elem) {
 
   list_insert_determine_name(l, new_elem->prev, new_elem);
 
+  registry_add(l, new_elem);
+
   l->size++;
 }
 
@@ -168,6 +175,8 @@ void list_delete(struct matrix_list *l, list_iter iter) {
 
     iter->prev = iter->prev->prev;
 
+    registry_remove(l, temporary);
+
     list_free_elem(temporary);
 
     l->size--;
@@ -179,6 +188,8 @@ void list_delete(struct matrix_list *l, list_iter iter) {
 
     iter = list_iter_next(iter);
 
+    registry_remove(l, temporary);
+
     list_free_elem(temporary);
 
     l->size--;
@@ -196,4 +207,148 @@ void list_destroy(struct matrix_list *l) {
     list_free_elem(elem);
     elem = next;
   }
+
+  l->entries.clear();
+  l->free_slots.clear();
+  l->bound.assign(l->symbols.size(), -1);
+}
+
+/**
+ * Returns the symbol of the passed in name, interning the name first if it has
+ * not been seen before.
+ */
+int registry_intern(struct matrix_list *l, const std::string &name) {
+  std::unordered_map<std::string, int>::iterator found = l->symbol_ids.find(name);
+
+  if (found != l->symbol_ids.end()) {
+    return found->second;
+  }
+
+  l->symbols.push_back(name);
+  l->bound.push_back(-1);
+  l->symbol_ids[name] = l->symbols.size() - 1;
+
+  return l->symbols.size() - 1;
+}
+
+/**
+ * Returns the symbol of the passed in name or -1 if the name has never been
+ * interned.
+ */
+int registry_find_symbol(struct matrix_list *l, const std::string &name) {
+  std::unordered_map<std::string, int>::iterator found = l->symbol_ids.find(name);
+
+  if (found == l->symbol_ids.end()) {
+    return -1;
+  }
+
+  return found->second;
+}
+
+/**
+ * Stores the matrix of the passed in list element in the registry under the
+ * name of the element and gives the element its handle.
+ */
+void registry_add(struct matrix_list *l, struct list_elem *elem) {
+  std::string name;
+
+  for (int i = 0; i < elem->name_size; i++) {
+    name.push_back((char) elem->name[i]);
+  }
+
+  int slot;
+
+  if (l->free_slots.empty()) {
+    l->entries.push_back(registry_entry());
+    slot = l->entries.size() - 1;
+  } else {
+    slot = l->free_slots.back();
+    l->free_slots.pop_back();
+  }
+
+  struct registry_entry *entry = &l->entries[slot];
+  entry->matrix = elem->elem;
+  entry->elem = elem;
+  entry->symbol = registry_intern(l, name);
+
+  l->bound[entry->symbol] = slot;
+
+  elem->handle.slot = slot;
+  elem->handle.generation = entry->generation;
+}
+
+/**
+ * Removes the matrix of the passed in list element from the registry. Every
+ * handle to it becomes stale.
+ */
+void registry_remove(struct matrix_list *l, struct list_elem *elem) {
+  int slot = elem->handle.slot;
+
+  if (slot < 0 || slot >= (int) l->entries.size()) {
+    return;
+  }
+
+  struct registry_entry *entry = &l->entries[slot];
+
+  if (entry->generation != elem->handle.generation || entry->matrix == nullptr) {
+    return;
+  }
+
+  if (l->bound[entry->symbol] == slot) {
+    l->bound[entry->symbol] = -1;
+  }
+
+  entry->matrix = nullptr;
+  entry->elem = nullptr;
+  entry->symbol = -1;
+  entry->generation++;
+
+  l->free_slots.push_back(slot);
+
+  elem->handle.slot = -1;
+}
+
+/**
+ * Finds the matrix currently carrying the name of the passed in symbol and
+ * stores its handle. Returns false if there is no such matrix.
+ */
+bool registry_lookup(struct matrix_list *l, int symbol, struct matrix_handle *handle) {
+  if (symbol < 0 || symbol >= (int) l->bound.size() || l->bound[symbol] < 0) {
+    return false;
+  }
+
+  handle->slot = l->bound[symbol];
+  handle->generation = l->entries[handle->slot].generation;
+
+  return true;
+}
+
+/**
+ * Returns the matrix the passed in handle refers to or a null pointer if the
+ * handle is stale.
+ */
+Matrix* registry_get(struct matrix_list *l, struct matrix_handle handle) {
+  if (handle.slot < 0 || handle.slot >= (int) l->entries.size()) {
+    return nullptr;
+  }
+
+  struct registry_entry *entry = &l->entries[handle.slot];
+
+  if (entry->generation != handle.generation) {
+    return nullptr;
+  }
+
+  return entry->matrix;
+}
+
+/**
+ * Returns the matrix currently carrying the name of the passed in symbol or a
+ * null pointer if there is none.
+ */
+Matrix* registry_resolve(struct matrix_list *l, int symbol) {
+  if (symbol < 0 || symbol >= (int) l->bound.size() || l->bound[symbol] < 0) {
+    return nullptr;
+  }
+
+  return l->entries[l->bound[symbol]].matrix;
 }
@@ -22,14 +22,51 @@
 #ifndef __MATRIX_LIST_H_INCLUDED__
 #define __MATRIX_LIST_H_INCLUDED__
 
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "matrix.h"
 
 typedef struct list_elem *list_iter;
 
+/**
+ * A handle to a matrix in the registry of a matrix list. The generation of a
+ * slot is increased every time its matrix is deleted, so a handle to a deleted
+ * matrix is recognised as stale even after the slot has been reused.
+ */
+struct matrix_handle {
+  int slot = -1;
+  unsigned generation = 0;
+};
+
+/**
+ * An entry of the registry. The matrix is a null pointer while the slot is
+ * free.
+ */
+struct registry_entry {
+  Matrix *matrix = nullptr;
+  struct list_elem *elem = nullptr;
+  int symbol = -1;
+  unsigned generation = 0;
+};
+
+/**
+ * The matrix list keeps the matrices in the order in which they are shown to
+ * the user. The registry stores an entry for every matrix contiguously and
+ * indexes it by interned name, so a matrix can be found by name in constant
+ * time. Interned names are never forgotten, so the symbol of a name stays the
+ * same for the whole session, while bound maps every symbol to the slot of the
+ * matrix currently carrying that name or -1.
+ */
 struct matrix_list {
   struct list_elem *header;
   struct list_elem *footer;
   int size;
+  std::vector<struct registry_entry> entries;
+  std::vector<int> free_slots;
+  std::vector<std::string> symbols;
+  std::unordered_map<std::string, int> symbol_ids;
+  std::vector<int> bound;
 };
 
 struct list_elem {
@@ -38,6 +75,7 @@ struct list_elem {
   int *name = nullptr;
   int name_size = 0;
   Matrix *elem = nullptr;
+  struct matrix_handle handle;
 };
 
 struct list_elem * list_alloc_elem(void);
@@ -53,5 +91,12 @@ void list_insert_front(struct matrix_list *l, Matrix *elem);
 void list_insert_back(struct matrix_list *l, Matrix *elem);
 void list_delete(struct matrix_list *l, list_iter iter);
 void list_destroy(struct matrix_list *l);
+int registry_intern(struct matrix_list *l, const std::string &name);
+int registry_find_symbol(struct matrix_list *l, const std::string &name);
+void registry_add(struct matrix_list *l, struct list_elem *elem);
+void registry_remove(struct matrix_list *l, struct list_elem *elem);
+bool registry_lookup(struct matrix_list *l, int symbol, struct matrix_handle *handle);
+Matrix* registry_get(struct matrix_list *l, struct matrix_handle handle);
+Matrix* registry_resolve(struct matrix_list *l, int symbol);
 
 #endif
@@ -0,0 +1,113 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include "memo_cache.h"
+
+using namespace std;
+
+/**
+ * Returns the number of bytes the elements of the passed in matrix occupy.
+ */
+static size_t matrix_size(Matrix *m) {
+  return (size_t)m->get_rows() * m->get_columns() * sizeof(Fraction);
+}
+
+/**
+ * Returns a newly allocated copy of the passed in matrix.
+ */
+static Matrix* copy_matrix(Matrix *m) {
+  Matrix *copy = new Matrix(m->get_rows(), m->get_columns());
+  *copy = *m;
+  return copy;
+}
+
+/**
+ * Removes the least recently used result from the cache.
+ */
+static void evict(struct memo_cache *c) {
+  Matrix *result = c->entries.back().second;
+
+  c->size -= matrix_size(result);
+  c->index.erase(c->entries.back().first);
+  c->entries.pop_back();
+
+  delete result;
+}
+
+/**
+ * Returns a newly allocated copy of the result stored under the passed in key
+ * and marks it as the most recently used one. Returns a null pointer if there
+ * is none.
+ */
+Matrix* memo_cache_find(struct memo_cache *c, const string &key) {
+  lock_guard<mutex> guard(c->lock);
+
+  unordered_map<string, memo_cache_iter>::iterator found = c->index.find(key);
+
+  if (found == c->index.end()) {
+    c->misses++;
+    return nullptr;
+  }
+
+  c->hits++;
+
+  c->entries.splice(c->entries.begin(), c->entries, found->second);
+
+  return copy_matrix(found->second->second);
+}
+
+/**
+ * Stores a copy of the passed in result under the passed in key, evicting the
+ * least recently used results until it fits in the budget. Results larger than
+ * the whole budget are not stored.
+ */
+void memo_cache_insert(struct memo_cache *c, const string &key, Matrix *result) {
+  size_t size = matrix_size(result);
+
+  if (size > c->budget) {
+    return;
+  }
+
+  lock_guard<mutex> guard(c->lock);
+
+  if (c->index.find(key) != c->index.end()) {
+    return;
+  }
+
+  while (!c->entries.empty() && c->size + size > c->budget) {
+    evict(c);
+  }
+
+  c->entries.push_front(make_pair(key, copy_matrix(result)));
+  c->index[key] = c->entries.begin();
+  c->size += size;
+}
+
+/**
+ * Removes every result from the cache.
+ */
+void memo_cache_clear(struct memo_cache *c) {
+  lock_guard<mutex> guard(c->lock);
+
+  while (!c->entries.empty()) {
+    evict(c);
+  }
+}
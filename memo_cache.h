@@ -0,0 +1,62 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __MEMO_CACHE_H_INCLUDED__
+#define __MEMO_CACHE_H_INCLUDED__
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "matrix.h"
+
+/**
+ * The number of bytes of matrix elements kept by the cache used by the
+ * calculator.
+ */
+#define MEMO_CACHE_BUDGET (32u << 20)
+
+typedef std::list<std::pair<std::string, Matrix*> >::iterator memo_cache_iter;
+
+/**
+ * A least recently used cache mapping the key of a computation to its result.
+ * A key names the operation together with the ids and versions of the saved
+ * matrices it was computed from, so editing a matrix invalidates every result
+ * depending on it. Once the results exceed the budget, the least recently used
+ * ones are evicted. The lock allows the cache to be used by the workers of a
+ * parallel execution.
+ */
+struct memo_cache {
+  std::list<std::pair<std::string, Matrix*> > entries;
+  std::unordered_map<std::string, memo_cache_iter> index;
+  size_t budget = MEMO_CACHE_BUDGET;
+  size_t size = 0;
+  unsigned long hits = 0;
+  unsigned long misses = 0;
+  std::mutex lock;
+};
+
+Matrix* memo_cache_find(struct memo_cache *c, const std::string &key);
+void memo_cache_insert(struct memo_cache *c, const std::string &key, Matrix *result);
+void memo_cache_clear(struct memo_cache *c);
+
+#endif
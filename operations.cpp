@@ -19,17 +19,53 @@
  * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
  */
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <stack>
+#include "charpoly.h"
+#include "lu.h"
 #include "matrix_list.h"
 #include "operations.h"
+#include "pool.h"
 #include <FL/fl_ask.H>
 #include <FL/Fl_Check_Button.H>
 
 using namespace std;
 
+/**
+ * When set, the errors reported by the current thread are stored here instead
+ * of being shown, because only the main thread may open a dialog.
+ */
+static thread_local string *deferred_error = nullptr;
+
+/**
+ * Makes the errors reported by the current thread go to the passed in string
+ * instead of being shown to the user. Only the first error is kept. Passing a
+ * null pointer shows the errors again.
+ */
+void defer_errors(string *error) {
+  deferred_error = error;
+}
+
+/**
+ * Shows the passed in error to the user, or stores it if the errors of the
+ * current thread are deferred.
+ */
+void report_error(const char *message) {
+  if (deferred_error != nullptr) {
+    if (deferred_error->empty()) {
+      *deferred_error = message;
+    }
+    return;
+  }
+
+  fl_alert("%s", message);
+}
+
 /**
  * Adds two matrices if their dimensions match, else returns a null pointer.
  * POSSIBLE FUTURE ALTERNATIVE: See the suggested alternative in matrix.cpp.
@@ -38,7 +74,7 @@ Matrix* add(Matrix *a, Matrix *b) {
   if (a->get_rows() == b->get_rows() && a->get_columns() == b->get_columns()) {
     return *a + *b;
   } else {
-    fl_alert("The matrices' dimensions do not match!");
+    report_error("The matrices' dimensions do not match!");
     return nullptr;
   }
 }
@@ -51,7 +87,7 @@ Matrix* subtract(Matrix *a, Matrix *b) {
   if (a->get_rows() == b->get_rows() && a->get_columns() == b->get_columns()) {
     return *a - *b;
   } else {
-    fl_alert("The matrices' dimensions do not match!");
+    report_error("The matrices' dimensions do not match!");
     return nullptr;
   }
 }
@@ -64,11 +100,64 @@ Matrix* multiply(Matrix *a, Matrix *b) {
   if (a->get_columns() == b->get_rows()) {
     return *a * *b;
   } else {
-    fl_alert("The matrices' dimensions do not match!");
+    report_error("The matrices' dimensions do not match!");
     return nullptr;
   }
 }
 
+/**
+ * Multiplies two matrices if their dimensions match, else returns a null
+ * pointer. The product is computed block by block, so that the blocks of both
+ * matrices which are being combined stay in the cache. Zero elements of the
+ * first matrix are skipped and bands of rows are computed in parallel.
+ */
+Matrix* multiply_blocked(Matrix *a, Matrix *b) {
+  if (a->get_columns() != b->get_rows()) {
+    report_error("The matrices' dimensions do not match!");
+    return nullptr;
+  }
+
+  int a_rows = a->get_rows();
+  int a_columns = a->get_columns();
+  int b_columns = b->get_columns();
+
+  Matrix *c = new Matrix(a_rows, b_columns);
+
+  // Every band of BLOCK_SIZE rows of the product is computed independently,
+  // so the bands are split between threads when there is more than one.
+  function<void(int, int)> bands = [&](int from, int to) {
+    for (int ii = from * BLOCK_SIZE; ii < min(to * BLOCK_SIZE, a_rows); ii += BLOCK_SIZE) {
+      for (int kk = 0; kk < a_columns; kk += BLOCK_SIZE) {
+        for (int jj = 0; jj < b_columns; jj += BLOCK_SIZE) {
+          for (int i = ii; i < min(ii + BLOCK_SIZE, a_rows); i++) {
+            for (int k = kk; k < min(kk + BLOCK_SIZE, a_columns); k++) {
+              Fraction aik = a->elements[i * a_columns + k];
+
+              if (aik == Fraction ()) {
+                continue;
+              }
+
+              for (int j = jj; j < min(jj + BLOCK_SIZE, b_columns); j++) {
+                c->elements[i * b_columns + j] += aik * b->elements[k * b_columns + j];
+              }
+            }
+          }
+        }
+      }
+    }
+  };
+
+  int band_count = (a_rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  if (band_count > 1) {
+    pool_parallel_for(shared_pool(), 0, band_count, 1, bands);
+  } else {
+    bands(0, band_count);
+  }
+
+  return c;
+}
+
 /**
  * Multiplies a matrix by a number.
  */
@@ -92,111 +181,51 @@ Matrix* transpose(Matrix *a) {
 }
 
 /**
- * Returns the reduced row echelon form of the passed in matrix.
- * POSSIBLE FUTURE ALTERNATIVE: Split the function into four smaller ones to
- * increase readibility and clarity.
+ * Returns the reduced row echelon form of the passed in matrix, derived from
+ * its LU factorisation.
  */
 Matrix* reduced_row_echelon_form(Matrix *a) {
-  // Create a new matrix to hold the reduced row echelon form.
-  Matrix *c = new Matrix(a->get_rows(), a->get_columns());
-
-  // Copy the passed in matrix.
-  *c = *a;
-
-  // Create a counter for the columns.
-  int j = 0;
-
-  for (int i = 0; i < a->get_rows(); i++) {
-
-    // If j is greater than the number of columns return the result.
-    if (j >= a->get_columns()) {
-      return c;
-    }
-
-    // Create a boolean to check whether all elements in the column j are zero.
-    bool are_all_zero = true;
-
-    // Check the value of each element in column j.
-    for (int k = 0; k < a->get_rows(); k++) {
-      if (c->elements[k * a->get_columns() + j] != Fraction ()) {
-        are_all_zero = false;
-      }
-    }
-
-    // Go to next iteration if there is a non-zero element.
-    if (are_all_zero) {
-      j++;
-      continue;
-    }
+  return lu_reduced_row_echelon_form(lu_factorise(a).get());
+}
 
-    // If the element at location [i, j] is zero, then swap the current row
-    // with the first row, which is below the current row and has a non-zero
-    // element at location [x, j] where x is the row number.
-    if (c->elements[i * a->get_columns() + j] == Fraction ()) {
-      // Create a boolean to check whether all elements below the current
-      // element in column j are zero.
-      bool are_all_below_zero = true;
-
-      // If a non-zero element is discovered, swap the rows.
-      for (int p = i + 1; p < a->get_rows(); p++) {
-        if (c->elements[p * a->get_columns() + j] != Fraction ()) {
-          are_all_below_zero = false;
-          for (int q = 0; q < a->get_columns(); q++) {
-            swap(c->elements[i * a->get_columns() + q], c->elements[p * a->get_columns() + q]);
-          }
-          break;
-        }
-      }
+/**
+ * Swaps the values of the fractions at the two addresses.
+ */
+void swap(Fraction *a, Fraction *b) {
+  Fraction temp = *a;
+  *a = *b;
+  *b = temp;
+}
 
-      // If all elements are zero go to the next column, while keeping the row
-      // the same.
-      if (are_all_below_zero) {
-        j++;
-        i--;
-        continue;
-      }
-    }
+/**
+ * Checks whether the passed in fraction is zero. Subtractions may leave a zero
+ * with a negative sign, which does not compare equal to Fraction ().
+ */
+bool is_zero(const Fraction &f) {
+  return f[0] == 0;
+}
 
-    // Create a copy of the element at location [i, j].
-    Fraction aij = c->elements[i * a->get_columns() + j];
-
-    // Divide each element at row i by the element at location [i, j] in order
-    // to make the pivot 1. The above copy of the element at location [i, j] is
-    // needed after the first division the element will become one and all
-    // subsequent elements will be divided by 1 and remain the same.
-    // POSSIBLE FUTURE ALTERNATIVE: Perform the division in reverse.
-    for (int d = 0; d < a->get_columns(); d++) {
-      c->elements[i * a->get_columns() + d] /= aij;
-      if (c->elements[i * a->get_columns() + d].operator[](0) == (-0)) {
-        c->elements[i * a->get_columns() + d] = Fraction ();
-      }
-    }
+/**
+ * Returns the number of bits needed to write the passed in number.
+ */
+static int bit_length(unsigned int number) {
+  int bits = 0;
 
-    // For each row k different from i, subtract a multiple of i (i multiplied
-    // by the element at location [k, j]) such that all elements above and below
-    // the pivot element in i become 0.
-    for (int k = 0; k < a->get_rows(); k++) {
-      if (k == i) {
-        continue;
-      } else {
-        Fraction akj = c->elements[k * a->get_columns() + j];
-        for (int d = 0; d < a->get_columns(); d++) {
-          c->elements[k * a->get_columns() + d] -= (c->elements[i * a->get_columns() + d] * akj);
-        }
-      }
-    }
+  while (number != 0) {
+    number >>= 1;
+    bits++;
   }
 
-  return c;
+  return bits;
 }
 
 /**
- * Swaps the values of the fractions at the two addresses.
+ * Returns the height of the passed in fraction, the bit size of the larger of
+ * its numerator and denominator. Pivots of a small height keep the numbers of
+ * an elimination small.
  */
-void swap(Fraction *a, Fraction *b) {
-  Fraction temp = *a;
-  *a = *b;
-  *b = temp;
+int height(const Fraction &f) {
+  return max(bit_length(abs(f[0])), bit_length(f[1]));
 }
 
 /**
@@ -276,49 +305,213 @@ bool compare_elements(Matrix *from, Matrix *to) {
   }
 }
 
+/**
+ * Returns a newly allocated copy of the block of the passed in matrix with the
+ * passed in dimensions whose top left element is at [row, column].
+ */
+static Matrix* submatrix(Matrix *a, int row, int column, int rows, int columns) {
+  Matrix *block = new Matrix(rows, columns);
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      block->elements[i * columns + j] = a->elements[(row + i) * a->get_columns() + column + j];
+    }
+  }
+
+  return block;
+}
+
+/**
+ * Copies the passed in block into the matrix with its top left element at
+ * [row, column], negating it if negate is set.
+ */
+static void place(Matrix *into, Matrix *block, int row, int column, bool negate) {
+  for (int i = 0; i < block->get_rows(); i++) {
+    for (int j = 0; j < block->get_columns(); j++) {
+      Fraction element = block->elements[i * block->get_columns() + j];
+      into->elements[(row + i) * into->get_columns() + column + j] = negate && element[0] != 0 ? -element : element;
+    }
+  }
+}
+
+/**
+ * Inverts a square matrix by splitting it into the blocks [A B; C D]. With the
+ * Schur complement S = D - C * A^-1 * B, which is inverted recursively as well,
+ * the inverse is [A^-1 + T * S^-1 * U, -T * S^-1; -S^-1 * U, S^-1], where
+ * T = A^-1 * B and U = C * A^-1. This is the block LU factorisation
+ * [I 0; U I] * [A B; 0 S] turned into an inverse, so most of the work is done by
+ * the blocked multiplication. Small blocks are inverted through their LU
+ * factorisation. Returns a null pointer without alerting the user if A or S is
+ * singular, even though the matrix itself may not be.
+ */
+static Matrix* block_inverse(Matrix *a) {
+  int n = a->get_rows();
+
+  if (n <= BLOCK_INVERSE_SIZE) {
+    return lu_inverse(lu_factorise(a).get());
+  }
+
+  int h = n / 2;
+  int rest = n - h;
+
+  Matrix *a11 = submatrix(a, 0, 0, h, h);
+  Matrix *inverse11 = block_inverse(a11);
+
+  delete a11;
+
+  if (inverse11 == nullptr) {
+    return nullptr;
+  }
+
+  Matrix *a12 = submatrix(a, 0, h, h, rest);
+  Matrix *a21 = submatrix(a, h, 0, rest, h);
+  Matrix *a22 = submatrix(a, h, h, rest, rest);
+
+  Matrix *t = multiply_blocked(inverse11, a12);
+  Matrix *u = multiply_blocked(a21, inverse11);
+  Matrix *ct = multiply_blocked(a21, t);
+  Matrix *schur = subtract(a22, ct);
+
+  delete a12;
+  delete a21;
+  delete a22;
+  delete ct;
+
+  Matrix *inverse22 = block_inverse(schur);
+
+  delete schur;
+
+  if (inverse22 == nullptr) {
+    delete inverse11;
+    delete t;
+    delete u;
+    return nullptr;
+  }
+
+  Matrix *x12 = multiply_blocked(t, inverse22);
+  Matrix *x21 = multiply_blocked(inverse22, u);
+  Matrix *correction = multiply_blocked(x12, u);
+  Matrix *x11 = add(inverse11, correction);
+
+  Matrix *inverse = new Matrix(n, n);
+
+  place(inverse, x11, 0, 0, false);
+  place(inverse, x12, 0, h, true);
+  place(inverse, x21, h, 0, true);
+  place(inverse, inverse22, h, h, false);
+
+  delete inverse11;
+  delete inverse22;
+  delete t;
+  delete u;
+  delete x12;
+  delete x21;
+  delete correction;
+  delete x11;
+
+  return inverse;
+}
+
 /**
  * Returns the inverse of a matrix if one exists, else returns a null pointer.
- * POSSIBLE FUTURE ALTERNATIVE: Optimize the deletion of the allocated resources.
+ * Large matrices are inverted block by block, while small ones and those whose
+ * leading blocks are singular are solved for from their LU factorisation.
  */
 Matrix* invert(Matrix *a) {
   if (a->get_rows() != a->get_columns()) {
-    fl_alert("The matrices' dimensions do not match!");
+    report_error("The matrices' dimensions do not match!");
+    return nullptr;
+  }
+
+  if (a->get_rows() > BLOCK_INVERSE_SIZE) {
+    Matrix *inverse = block_inverse(a);
+
+    if (inverse != nullptr) {
+      return inverse;
+    }
+  }
+
+  shared_ptr<const struct lu_factors> factors = lu_factorise(a);
+
+  if (factors->rank < a->get_rows()) {
+    report_error("The matrix is singular!");
     return nullptr;
   }
 
-  if (determinant(a) == Fraction ()) {
-    fl_alert("The matrix is singular!");
+  return lu_inverse(factors.get());
+}
+
+/**
+ * Multiplies two square matrices of the same size with the blocked kernel once
+ * they no longer fit in a block.
+ */
+static Matrix* multiply_square(Matrix *a, Matrix *b) {
+  return a->get_rows() > BLOCK_SIZE ? multiply_blocked(a, b) : multiply(a, b);
+}
+
+/**
+ * Raises a square matrix to an integer power by repeated squaring, which takes
+ * at most two products for every bit of the exponent instead of one product
+ * for every factor. A negative power is the power of the inverse, so it
+ * returns a null pointer if the matrix is singular. The exponent must not be
+ * INT_MIN.
+ */
+Matrix* power(Matrix *a, int exponent) {
+  int n = a->get_rows();
+
+  if (n != a->get_columns()) {
+    report_error("The matrices' dimensions do not match!");
     return nullptr;
   }
 
-  Matrix *i_elements = identity_matrix(a->get_rows(), a->get_columns());
+  if (exponent < 0) {
+    Matrix *inverse = invert(a);
 
-  Matrix *augmented = put_together(a, i_elements);
+    if (inverse == nullptr) {
+      return nullptr;
+    }
 
-  Matrix *rref = reduced_row_echelon_form(augmented);
+    Matrix *result = power(inverse, -exponent);
+    delete inverse;
 
-  Matrix *b = new Matrix(a->get_rows(), a->get_columns());
-  Matrix *c = new Matrix(a->get_rows(), a->get_columns());
+    return result;
+  }
 
-  split_apart(rref, b, c);
+  // The square holds a to the power of the current bit of the exponent and the
+  // result the product of the squares of the bits seen so far.
+  Matrix *result = nullptr;
+  Matrix *square = a;
 
-  if (compare_elements(b, i_elements)) {
-    delete i_elements;
-    delete augmented;
-    delete rref;
-    delete b;
+  while (exponent > 0) {
+    if (exponent & 1) {
+      if (result == nullptr) {
+        result = new Matrix(n, n);
+        *result = *square;
+      } else {
+        Matrix *product = multiply_square(result, square);
+        delete result;
+        result = product;
+      }
+    }
 
-    return c;
-  } else {
-    delete i_elements;
-    delete augmented;
-    delete rref;
-    delete b;
-    delete c;
+    exponent >>= 1;
 
-    fl_alert("The matrix doesn't have an inverse.");
-    return nullptr;
+    if (exponent > 0) {
+      Matrix *next = multiply_square(square, square);
+
+      if (square != a) {
+        delete square;
+      }
+
+      square = next;
+    }
   }
+
+  if (square != a) {
+    delete square;
+  }
+
+  return result != nullptr ? result : identity_matrix(n, n);
 }
 
 /**
@@ -330,6 +523,8 @@ Fraction determinant(Matrix *a) {
 
   if (a->get_rows() != a->get_columns()) {
 
+  } else if (a->get_rows() == 1) {
+    det = a->elements[0];
   } else if (a->get_rows() == 2 && a->get_columns() == 2) {
     det = a->elements[3] * a->elements[0] - a->elements[1] * a->elements[2];
   } else {
@@ -353,3 +548,45 @@ Fraction determinant(Matrix *a) {
 
   return det;
 }
+
+/**
+ * Returns the determinant of a matrix read off its LU factorisation, which
+ * takes a number of operations cubic in the size of the matrix rather than
+ * factorial like the cofactor expansion in determinant. Returns zero for a
+ * matrix which is not square, like determinant does.
+ *
+ * The factorisation of an integer matrix is only exact while its minors fit
+ * in a fraction. If one of them did not, the elimination fell back to
+ * fractions which may have overflowed, so the determinant is found without
+ * divisions instead: by cofactor expansion for small matrices and as the
+ * constant term of the characteristic polynomial for larger ones.
+ */
+Fraction determinant_elimination(Matrix *a) {
+  int n = a->get_rows();
+
+  if (n != a->get_columns()) {
+    return Fraction ();
+  }
+
+  shared_ptr<const struct lu_factors> factors = lu_factorise(a);
+
+  if (factors->fraction_free) {
+    return factors->determinant;
+  }
+
+  for (int i = 0; i < n * n; i++) {
+    if (a->elements[i][1] != 1) {
+      return factors->determinant;
+    }
+  }
+
+  if (n <= COFACTOR_LIMIT) {
+    return determinant(a);
+  }
+
+  Matrix *polynomial = characteristic_polynomial(a);
+  Fraction det = n % 2 == 0 ? polynomial->elements[n] : -polynomial->elements[n];
+  delete polynomial;
+
+  return det;
+}
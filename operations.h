@@ -25,18 +25,41 @@
 #include <string>
 #include "matrix.h"
 
+/**
+ * The size of the square blocks used by multiply_blocked.
+ */
+#define BLOCK_SIZE 32
+
+/**
+ * The size above which invert splits a matrix into blocks.
+ */
+#define BLOCK_INVERSE_SIZE (2 * BLOCK_SIZE)
+
+/**
+ * The largest size of a matrix whose determinant determinant_elimination finds
+ * by cofactor expansion when the elimination cannot be exact.
+ */
+#define COFACTOR_LIMIT 8
+
+void defer_errors(std::string *error);
+void report_error(const char *message);
 Matrix* add(Matrix *a, Matrix *b);
 Matrix* subtract(Matrix *a, Matrix *b);
 Matrix* multiply(Matrix *a, Matrix *b);
+Matrix* multiply_blocked(Matrix *a, Matrix *b);
 Matrix* multiply_by_number(Matrix *a, double number);
 Matrix* transpose(Matrix *a);
 Matrix* reduced_row_echelon_form(Matrix *a);
 void swap(Fraction *a, Fraction *b);
+bool is_zero(const Fraction &f);
+int height(const Fraction &f);
 Matrix* identity_matrix(int rows, int columns);
 Matrix* put_together(Matrix *a, Matrix *b);
 void split_apart(Matrix *from, Matrix *a, Matrix *b);
 bool compare_elements(Matrix *from, Matrix *to);
 Matrix* invert(Matrix *a);
+Matrix* power(Matrix *a, int exponent);
 Fraction determinant(Matrix *a);
+Fraction determinant_elimination(Matrix *a);
 
 #endif
@@ -22,40 +22,12 @@
 #ifndef __PARSER_H_INCLUDED__
 #define __PARSER_H_INCLUDED__
 
-#include <list>
-#include <stack>
+#include <vector>
+#include "lexer.h"
 #include "matrix.h"
 #include "matrix_list.h"
 
-/**
- * Enumeration used to weigh the precedence on an operator.
- */
-enum precedence_value {NONE = 0, LOW = 1, MEDIUM = 2, HIGH = 3, VERY_HIGH = 4, VERY_VERY_HIGH};
-
-/**
- * A struct used to hold an operator and it's precedence.
- */
-struct precedence
-{
-  char op;
-  precedence_value prec;
-};
-
-bool compare_names(int *first, int *second, int name_size);
-Matrix* find_matrix(struct matrix_list *l, int *name, int name_size);
-int find_size_next_argument(std::list<char> lst);
-void get_next_argument(std::list<char> *lst, int *name, int size);
-double get_next_numeric_argument(std::list<char> *lst, int size);
-bool correct_expression(char *value);
-precedence_value find_precedence(char character);
-bool check_precedence_low(char character);
-bool check_precedence_medium(char character);
-bool check_precedence_high(char character);
-void operator_logic(stack<char> *output, stack<char> *operands, bool (*function_ptr)(char), char *current);
-char* infix_to_postfix(char *data);
-void clean_memory(struct matrix_list *l, int counter);
-void check_existance(int *name_arg_1, int name_size_arg_1, Matrix **matrix_1, struct matrix_list *l);
-void clean_up(list<char> lst, struct matrix_list *l, list_iter l_iter, int counter, int **name_arg_1, int **name_arg_2);
-Matrix* calculate(struct matrix_list *l, list_iter l_iter, char *postfix);
+Matrix* find_matrix(struct matrix_list *l, const char *name, int name_size);
+void infix_to_postfix(const std::vector<struct token> &tokens, std::vector<struct token> *postfix);
 
 #endif
@@ -0,0 +1,1015 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include "charpoly.h"
+#include "factors.h"
+#include "memo_cache.h"
+#include "operations.h"
+#include "parser.h"
+#include "plan.h"
+#include "pool.h"
+#include "solver.h"
+#include "sparse.h"
+#include "sparse_lu.h"
+#include "structure.h"
+#include "verify.h"
+#include <FL/fl_ask.H>
+
+using namespace std;
+
+/**
+ * An entry of the stack used by the compiler. It refers either to the
+ * instruction producing a matrix or to one of the numbers of the plan, because
+ * numbers are only ever consumed by the instructions scaling a matrix or
+ * raising it to a power.
+ */
+struct compiler_entry {
+  bool number;
+  int index;
+};
+
+/**
+ * Returns the index of the instruction with the passed in fields, appending it
+ * to the plan unless an identical instruction already exists. The operands of
+ * an addition are ordered, so that A'+B' and B'+A' share an instruction.
+ */
+int plan_instruction(struct plan *p, opcode op, int left, int right, int argument) {
+  if (op == OP_ADD && left > right) {
+    std::swap(left, right);
+  }
+
+  struct instruction_key key = {op, left, right, argument};
+  unordered_map<struct instruction_key, int, struct instruction_key_hash>::iterator found = p->index.find(key);
+
+  if (found != p->index.end()) {
+    return found->second;
+  }
+
+  p->code.push_back({op, left, right, argument, 0, KERNEL_DEFAULT});
+  p->index[key] = p->code.size() - 1;
+
+  return p->code.size() - 1;
+}
+
+/**
+ * Returns the index of the passed in number in the plan, appending it if it is
+ * not there yet.
+ */
+int plan_number(struct plan *p, double number) {
+  for (size_t i = 0; i < p->numbers.size(); i++) {
+    if (p->numbers[i] == number) {
+      return i;
+    }
+  }
+
+  p->numbers.push_back(number);
+
+  return p->numbers.size() - 1;
+}
+
+/**
+ * Removes the instructions which do not contribute to the root, renumbers the
+ * remaining ones and counts how many times the result of each of them is used.
+ * Has to be called after the instructions of a plan have been changed.
+ */
+void finish_plan(struct plan *p) {
+  vector<bool> reachable(p->code.size(), false);
+  vector<int> renumbered(p->code.size(), -1);
+  vector<struct instruction> code;
+
+  reachable[p->root] = true;
+
+  // The operands of an instruction always come before it, so walking the
+  // instructions backwards visits every instruction after all its consumers.
+  for (int i = p->root; i >= 0; i--) {
+    if (!reachable[i]) {
+      continue;
+    }
+
+    if (p->code[i].left >= 0) {
+      reachable[p->code[i].left] = true;
+    }
+
+    if (p->code[i].right >= 0) {
+      reachable[p->code[i].right] = true;
+    }
+  }
+
+  p->index.clear();
+
+  for (int i = 0; i <= p->root; i++) {
+    if (!reachable[i]) {
+      continue;
+    }
+
+    struct instruction ins = p->code[i];
+
+    ins.left = ins.left >= 0 ? renumbered[ins.left] : -1;
+    ins.right = ins.right >= 0 ? renumbered[ins.right] : -1;
+    ins.uses = 0;
+    ins.method = KERNEL_DEFAULT;
+
+    if (ins.left >= 0) {
+      code[ins.left].uses++;
+    }
+
+    if (ins.right >= 0) {
+      code[ins.right].uses++;
+    }
+
+    renumbered[i] = code.size();
+    p->index[{ins.op, ins.left, ins.right, ins.argument}] = code.size();
+    code.push_back(ins);
+  }
+
+  p->root = renumbered[p->root];
+  p->code.swap(code);
+  p->code[p->root].uses++;
+  p->estimates.clear();
+}
+
+/**
+ * Compiles the tokens of the passed in expression, given in postfix notation,
+ * into the passed in plan. The names of the matrices are interned here, so
+ * that executing the plan does not have to deal with any strings. Returns
+ * false and alerts the user if the expression cannot be compiled.
+ */
+bool compile_plan(struct matrix_list *l, const char *expression, const vector<struct token> &postfix, struct plan *p) {
+  // Simulates the evaluation of the expression, holding the instructions and
+  // numbers which have not been consumed yet.
+  vector<struct compiler_entry> entries;
+
+  p->code.clear();
+  p->numbers.clear();
+  p->index.clear();
+  p->root = -1;
+  p->estimates.clear();
+  p->times.clear();
+
+  for (size_t i = 0; i < postfix.size(); i++) {
+    const struct token &current = postfix[i];
+
+    if (current.type == TOKEN_MATRIX) {
+      // The terminating character is part of the name.
+      int symbol = registry_intern(l, string(expression + current.position, current.length));
+
+      if (registry_resolve(l, symbol) == nullptr) {
+        fl_alert("The matrix you want to use either does not exist or is not a matrix!");
+        return false;
+      }
+
+      entries.push_back({false, plan_instruction(p, OP_LOAD, -1, -1, symbol)});
+    } else if (current.type == TOKEN_NUMBER) {
+      entries.push_back({true, plan_number(p, current.number)});
+    } else if (is_unary_operator(current.op)) {
+      if (entries.empty()) {
+        fl_alert("This is not a valid expression!");
+        return false;
+      }
+
+      if (entries.back().number) {
+        fl_alert("The matrix you want to use either does not exist or is not a matrix!");
+        return false;
+      }
+
+      int operand = entries.back().index;
+      entries.pop_back();
+
+      switch (current.op) {
+        case '|':
+          operand = plan_instruction(p, OP_TRANSPOSE, operand, -1, 0);
+          break;
+        case '^':
+          operand = plan_instruction(p, OP_RREF, operand, -1, 0);
+          break;
+        case '&':
+          operand = plan_instruction(p, OP_INVERT, operand, -1, 0);
+          break;
+        case '#':
+          operand = plan_instruction(p, OP_DETERMINANT, operand, -1, 0);
+          break;
+        case '%':
+          operand = plan_instruction(p, OP_CHARPOLY, operand, -1, 0);
+          break;
+      }
+
+      entries.push_back({false, operand});
+    } else {
+      if (entries.size() < 2) {
+        fl_alert("This is not a valid expression!");
+        return false;
+      }
+
+      struct compiler_entry second = entries.back();
+      entries.pop_back();
+      struct compiler_entry first = entries.back();
+      entries.pop_back();
+
+      int result;
+
+      if (current.op == '~') {
+        // The exponent is kept in the instruction itself, so it has to be a
+        // whole number whose negation is an int as well.
+        if (first.number || !second.number) {
+          fl_alert("A matrix can only be raised to a whole number!");
+          return false;
+        }
+
+        double exponent = p->numbers[second.index];
+
+        if (exponent != floor(exponent) || fabs(exponent) > INT_MAX) {
+          fl_alert("A matrix can only be raised to a whole number!");
+          return false;
+        }
+
+        result = plan_instruction(p, OP_POWER, first.index, -1, (int) exponent);
+      } else if (!first.number && !second.number) {
+        if (current.op == '+') {
+          result = plan_instruction(p, OP_ADD, first.index, second.index, 0);
+        } else if (current.op == '-') {
+          result = plan_instruction(p, OP_SUBTRACT, first.index, second.index, 0);
+        } else if (current.op == '\\') {
+          result = plan_instruction(p, OP_SOLVE, first.index, second.index, 0);
+        } else {
+          result = plan_instruction(p, OP_MULTIPLY, first.index, second.index, 0);
+        }
+      } else if (current.op == '*' && (!first.number || !second.number)) {
+        // Only multiplication can take a number and the number may stand on
+        // either side of the operator.
+        if (first.number) {
+          std::swap(first, second);
+        }
+
+        result = plan_instruction(p, OP_SCALE, first.index, -1, second.index);
+      } else {
+        fl_alert("The matrix you want to use either does not exist or is not a matrix!");
+        return false;
+      }
+
+      entries.push_back({false, result});
+    }
+  }
+
+  if (entries.size() != 1 || entries.back().number) {
+    fl_alert("This is not a valid expression!");
+    return false;
+  }
+
+  p->root = entries.back().index;
+
+  finish_plan(p);
+
+  return true;
+}
+
+/**
+ * Carries out an instruction with the kernel for the structure of its operands
+ * if there is one, storing the result in result. Products skip the zeros
+ * outside the bands of their operands, transposes of symmetric matrices are
+ * copies, determinants and inverses of triangular matrices need no
+ * elimination and RREFs of diagonal and triangular matrices are found by
+ * substitution. Returns false if the general kernels have to carry out the
+ * instruction instead, so that they alert the user of any mismatch.
+ */
+static bool run_structured(const struct instruction &ins, Matrix *left, Matrix *right, Matrix **result) {
+  struct matrix_structure s = structure_of(left);
+  bool square = left->get_rows() == left->get_columns();
+  bool triangular = (s.flags & (STRUCTURE_UPPER | STRUCTURE_LOWER)) != 0;
+
+  switch (ins.op) {
+    case OP_MULTIPLY: {
+      if (left->get_columns() != right->get_rows()) {
+        return false;
+      }
+
+      struct matrix_structure t = structure_of(right);
+
+      if (!is_structured(s) && !is_structured(t) && !(left == right && (s.flags & STRUCTURE_SYMMETRIC))) {
+        return false;
+      }
+
+      *result = structured_multiply(left, s, right, t);
+      return true;
+    }
+    case OP_TRANSPOSE:
+      if (!(s.flags & STRUCTURE_SYMMETRIC)) {
+        return false;
+      }
+
+      *result = structured_transpose(left);
+      return true;
+    case OP_RREF:
+      *result = structured_reduced_row_echelon_form(left, s);
+      return *result != nullptr;
+    case OP_INVERT:
+      if (!square || !triangular) {
+        return false;
+      }
+
+      *result = structured_inverse(left, s);
+      return true;
+    case OP_DETERMINANT:
+      if (!square || !triangular) {
+        return false;
+      }
+
+      *result = new Matrix(1, 1);
+      *(*result)->elements = structured_determinant(left);
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Carries out an instruction on the compressed forms of its operands if they
+ * are sparse enough, storing the result in result. Sums, differences, products
+ * and transposes use the sparse kernels, while RREFs, inverses and
+ * determinants come from a sparse elimination, so that no dense copy of the
+ * operand is made. Returns false if the dense kernels have to carry out the
+ * instruction instead, because an operand is too dense, the instruction is of
+ * another kind or the dimensions do not match, so that they alert the user.
+ */
+static bool run_sparse(const struct instruction &ins, Matrix *left, Matrix *right, Matrix **result) {
+  if (!is_sparse_matrix(left)) {
+    return false;
+  }
+
+  shared_ptr<const struct csr_matrix> a = csr_of(left);
+
+  struct csr_matrix *c;
+
+  switch (ins.op) {
+    case OP_TRANSPOSE:
+      c = csr_transpose(a.get());
+      break;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY: {
+      if (!is_sparse_matrix(right)) {
+        return false;
+      }
+
+      shared_ptr<const struct csr_matrix> b = csr_of(right);
+
+      if (ins.op == OP_MULTIPLY) {
+        if (a->columns != b->rows) {
+          return false;
+        }
+
+        c = csr_multiply(a.get(), b.get());
+      } else {
+        if (a->rows != b->rows || a->columns != b->columns) {
+          return false;
+        }
+
+        c = csr_add(a.get(), b.get(), ins.op == OP_SUBTRACT);
+      }
+      break;
+    }
+    case OP_RREF: {
+      unique_ptr<struct sparse_lu> echelon(sparse_eliminate(a.get(), true));
+      *result = sparse_reduced_row_echelon_form(echelon.get());
+      return true;
+    }
+    case OP_INVERT:
+      if (a->rows != a->columns) {
+        return false;
+      }
+
+      *result = sparse_inverse(sparse_factorise(left).get());
+
+      if (*result == nullptr) {
+        report_error("The matrix is singular!");
+      }
+      return true;
+    case OP_DETERMINANT:
+      if (a->rows != a->columns) {
+        return false;
+      }
+
+      *result = new Matrix(1, 1);
+      *(*result)->elements = sparse_factorise(left)->determinant;
+      return true;
+    default:
+      return false;
+  }
+
+  *result = csr_to_dense(shared_ptr<const struct csr_matrix>(c));
+
+  return true;
+}
+
+/**
+ * Carries out a single instruction other than OP_LOAD on the results of its
+ * operands. Returns the newly allocated result or a null pointer if the
+ * operation failed.
+ */
+static Matrix* run_instruction(struct plan *p, const struct instruction &ins, Matrix *left, Matrix *right) {
+  Matrix *result = nullptr;
+
+  // Operands with a known structure or sparse enough are handled without
+  // visiting their zeros.
+  if (ins.op != OP_SCALE && (run_structured(ins, left, right, &result) || run_sparse(ins, left, right, &result))) {
+    return result;
+  }
+
+  switch (ins.op) {
+    case OP_ADD:
+      result = add(left, right);
+      break;
+    case OP_SUBTRACT:
+      result = subtract(left, right);
+      break;
+    case OP_MULTIPLY:
+      if (ins.method == KERNEL_BLOCKED) {
+        result = multiply_blocked(left, right);
+      } else {
+        result = multiply(left, right);
+      }
+      break;
+    case OP_SCALE:
+      result = multiply_by_number(left, p->numbers[ins.argument]);
+      break;
+    case OP_TRANSPOSE:
+      result = transpose(left);
+      break;
+    case OP_RREF:
+      result = reduced_row_echelon_form(left);
+      break;
+    case OP_INVERT:
+      // Exact inverses are only found by refinement when it is chosen.
+      if (solve_get_method() == SOLVE_REFINED) {
+        result = solve_inverse(left);
+      } else {
+        result = invert(left);
+      }
+      break;
+    case OP_DETERMINANT:
+      result = new Matrix(1, 1);
+      if (ins.method == KERNEL_ELIMINATION) {
+        *result->elements = determinant_elimination(left);
+      } else {
+        *result->elements = determinant(left);
+      }
+      break;
+    case OP_SOLVE:
+      result = solve(left, right);
+      break;
+    case OP_POWER:
+      // A negative power is found from the inverse, refined if it is chosen.
+      if (ins.argument < 0 && solve_get_method() == SOLVE_REFINED) {
+        Matrix *inverse = solve_inverse(left);
+
+        if (inverse != nullptr) {
+          result = power(inverse, -ins.argument);
+          delete inverse;
+        }
+      } else {
+        result = power(left, ins.argument);
+      }
+      break;
+    case OP_CHARPOLY:
+      result = characteristic_polynomial(left);
+      break;
+    default:
+      break;
+  }
+
+  return result;
+}
+
+/**
+ * Checks whether the results of the passed in operation are worth keeping in
+ * the memo cache. Sums and differences are cheaper to recompute than to copy.
+ */
+static bool is_memoised(enum opcode op) {
+  switch (op) {
+    case OP_MULTIPLY:
+    case OP_TRANSPOSE:
+    case OP_RREF:
+    case OP_INVERT:
+    case OP_DETERMINANT:
+    case OP_POWER:
+    case OP_CHARPOLY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Builds the memo cache key of every instruction of the plan. An operand is
+ * named by the id and version of its matrix and every other instruction by its
+ * operation and the keys of its operands, so a key changes whenever one of the
+ * matrices it depends on is edited.
+ */
+static void memo_keys(struct plan *p, const vector<struct value> &values, vector<string> &keys) {
+  keys.resize(p->code.size());
+
+  for (size_t pc = 0; pc < p->code.size(); pc++) {
+    const struct instruction &ins = p->code[pc];
+    ostringstream key;
+
+    if (ins.op == OP_LOAD) {
+      key << values[pc].matrix->id << '.' << values[pc].matrix->version;
+    } else {
+      key << ins.op << '(' << keys[ins.left];
+
+      if (ins.right >= 0) {
+        key << ',' << keys[ins.right];
+      }
+
+      // The number is written with every digit it has, so that numbers which
+      // only differ after the sixth digit get keys of their own.
+      if (ins.op == OP_SCALE) {
+        key << ',' << setprecision(17) << p->numbers[ins.argument];
+      } else if (ins.op == OP_POWER) {
+        key << ',' << ins.argument;
+      }
+
+      key << ')';
+    }
+
+    keys[pc] = key.str();
+  }
+}
+
+/**
+ * Carries out an inversion or a determinant of a saved matrix. The result is
+ * kept for the matrix, so that asking for it again does not factorise the
+ * matrix again. Only what was asked for is computed. Once the inverse is kept,
+ * both also survive edits of single elements.
+ */
+static Matrix* evaluate_factored(struct plan *p, const struct instruction &ins, Matrix *operand) {
+  Matrix *result;
+  Fraction det;
+
+  if (ins.op == OP_INVERT) {
+    result = factors_inverse(operand);
+
+    if (result == nullptr) {
+      result = run_instruction(p, ins, operand, nullptr);
+
+      if (result != nullptr) {
+        factors_record_inverse(operand, result);
+      }
+    }
+
+    return result;
+  }
+
+  if (!factors_determinant(operand, &det)) {
+    result = run_instruction(p, ins, operand, nullptr);
+
+    if (result != nullptr) {
+      factors_record_determinant(operand, *result->elements);
+    }
+
+    return result;
+  }
+
+  result = new Matrix(1, 1);
+  *result->elements = det;
+
+  return result;
+}
+
+/**
+ * Checks a product, an inverse or an exact solution against its operands with
+ * Freivalds' test when verification is enabled. Deletes the result, alerts the
+ * user and returns a null pointer if it is wrong, and returns it otherwise.
+ */
+static Matrix* verify_result(const struct instruction &ins, Matrix *left, Matrix *right, Matrix *result) {
+  if (result == nullptr || !verify_get_enabled()) {
+    return result;
+  }
+
+  bool passed = true;
+
+  switch (ins.op) {
+    case OP_MULTIPLY:
+      passed = freivalds_product(left, right, result);
+      break;
+    case OP_INVERT:
+      passed = freivalds_inverse(left, result);
+      break;
+    case OP_SOLVE:
+      // The iterative methods only approximate the solution.
+      if (solve_get_method() == SOLVE_DIRECT || solve_get_method() == SOLVE_REFINED) {
+        passed = freivalds_product(left, result, right);
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (!passed) {
+    delete result;
+    report_error("The result failed verification!");
+    return nullptr;
+  }
+
+  return result;
+}
+
+/**
+ * Keeps the determinant of the operand of a characteristic polynomial, which is
+ * its constant term up to its sign, so that asking for the determinant next
+ * costs nothing. The determinant of a saved matrix is kept with its factors,
+ * where determinants of saved matrices are looked up, and any other one in the
+ * memo cache if there is one.
+ */
+static void keep_determinant(struct plan *p, struct memo_cache *memo, const vector<string> &keys,
+                             const struct instruction &ins, Matrix *operand, Matrix *result) {
+  if (result == nullptr || ins.op != OP_CHARPOLY) {
+    return;
+  }
+
+  int n = operand->get_rows();
+  Matrix det(1, 1);
+
+  *det.elements = n % 2 == 0 ? result->elements[n] : -result->elements[n];
+
+  if (p->code[ins.left].op == OP_LOAD) {
+    factors_record_determinant(operand, *det.elements);
+  } else if (memo != nullptr) {
+    ostringstream key;
+
+    key << OP_DETERMINANT << '(' << keys[ins.left] << ')';
+    memo_cache_insert(memo, key.str(), &det);
+  }
+}
+
+/**
+ * Carries out the instruction at the passed in index, reusing an earlier
+ * result from the memo cache when there is one and storing the new result
+ * otherwise. Inversions and determinants of saved matrices use their kept
+ * factors instead. Results are verified before they are kept.
+ */
+static Matrix* evaluate(struct plan *p, struct memo_cache *memo, const vector<string> &keys,
+                        int index, Matrix *left, Matrix *right) {
+  const struct instruction &ins = p->code[index];
+
+  if ((ins.op == OP_INVERT || ins.op == OP_DETERMINANT) && p->code[ins.left].op == OP_LOAD) {
+    return verify_result(ins, left, right, evaluate_factored(p, ins, left));
+  }
+
+  if (memo == nullptr || !is_memoised(ins.op)) {
+    Matrix *result = verify_result(ins, left, right, run_instruction(p, ins, left, right));
+
+    keep_determinant(p, memo, keys, ins, left, result);
+
+    return result;
+  }
+
+  Matrix *result = memo_cache_find(memo, keys[index]);
+
+  if (result == nullptr) {
+    result = verify_result(ins, left, right, run_instruction(p, ins, left, right));
+
+    if (result != nullptr) {
+      memo_cache_insert(memo, keys[index], result);
+    }
+
+    keep_determinant(p, memo, keys, ins, left, result);
+  }
+
+  return result;
+}
+
+/**
+ * Resolves the operands of the plan into the registers of their OP_LOAD
+ * instructions. Returns false and alerts the user if one of them no longer
+ * exists.
+ */
+static bool load_operands(struct matrix_list *l, struct plan *p, vector<struct value> &values) {
+  for (size_t pc = 0; pc < p->code.size(); pc++) {
+    if (p->code[pc].op != OP_LOAD) {
+      continue;
+    }
+
+    Matrix *operand = registry_resolve(l, p->code[pc].argument);
+
+    if (operand == nullptr) {
+      fl_alert("The matrix you want to use either does not exist or is not a matrix!");
+      return false;
+    }
+
+    values[pc] = {operand, false};
+  }
+
+  return true;
+}
+
+/**
+ * Deletes every owned result which is still alive.
+ */
+static void release_all(vector<struct value> &values) {
+  for (size_t i = 0; i < values.size(); i++) {
+    if (values[i].owned) {
+      delete values[i].matrix;
+      values[i].matrix = nullptr;
+    }
+  }
+}
+
+/**
+ * Checks whether some instruction of the plan consumes the results of two
+ * different computed instructions. If none does, the computed instructions
+ * form a single chain and there is nothing to run in parallel.
+ */
+static bool has_independent_work(struct plan *p) {
+  for (size_t i = 0; i < p->code.size(); i++) {
+    const struct instruction &ins = p->code[i];
+
+    if (ins.left >= 0 && ins.right >= 0 && ins.left != ins.right
+        && p->code[ins.left].op != OP_LOAD && p->code[ins.right].op != OP_LOAD) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Executes the plan one instruction after another on the calling thread.
+ */
+static void execute_serial(struct plan *p, struct memo_cache *memo, const vector<string> &keys,
+                           vector<struct value> &values, bool *failed) {
+  vector<int> remaining(p->code.size());
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    remaining[i] = p->code[i].uses;
+  }
+
+  for (size_t pc = 0; pc < p->code.size(); pc++) {
+    const struct instruction &ins = p->code[pc];
+
+    if (ins.op == OP_LOAD) {
+      continue;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    Matrix *left = values[ins.left].matrix;
+    Matrix *right = ins.right >= 0 ? values[ins.right].matrix : nullptr;
+    Matrix *result = evaluate(p, memo, keys, pc, left, right);
+
+    if (result == nullptr) {
+      *failed = true;
+      return;
+    }
+
+    values[pc] = {result, true};
+
+    // The result of an operand is deleted after its last use.
+    for (int operand : {ins.left, ins.right}) {
+      if (operand >= 0 && --remaining[operand] == 0 && values[operand].owned) {
+        delete values[operand].matrix;
+        values[operand].matrix = nullptr;
+      }
+    }
+
+    p->times[pc] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+}
+
+/**
+ * The state shared by the tasks executing a plan in parallel. An instruction
+ * is submitted to the pool once all the instructions it waits for are done.
+ */
+struct parallel_execution {
+  struct plan *p;
+  struct memo_cache *memo;
+  const vector<string> *keys;
+  vector<struct value> *values;
+  vector<vector<int> > consumers;
+  unique_ptr<atomic<int>[]> waiting;
+  unique_ptr<atomic<int>[]> remaining;
+  mutex lock;
+  condition_variable done;
+  int outstanding = 0;
+  bool failed = false;
+  string error;
+};
+
+static void submit_instruction(struct parallel_execution *execution, int index);
+
+/**
+ * Carries out one instruction of a plan executed in parallel, then submits the
+ * instructions which were only waiting for it.
+ */
+static void run_parallel_instruction(struct parallel_execution *execution, int index) {
+  struct plan *p = execution->p;
+  vector<struct value> &values = *execution->values;
+  const struct instruction &ins = p->code[index];
+  string error;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  // The alerts of the operations are deferred to the main thread.
+  defer_errors(&error);
+
+  Matrix *left = values[ins.left].matrix;
+  Matrix *right = ins.right >= 0 ? values[ins.right].matrix : nullptr;
+  Matrix *result = evaluate(p, execution->memo, *execution->keys, index, left, right);
+
+  defer_errors(nullptr);
+
+  if (result != nullptr) {
+    values[index] = {result, true};
+
+    for (int operand : {ins.left, ins.right}) {
+      if (operand >= 0 && --execution->remaining[operand] == 0 && values[operand].owned) {
+        delete values[operand].matrix;
+        values[operand].matrix = nullptr;
+      }
+    }
+
+    p->times[index] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool failed;
+    {
+      lock_guard<mutex> guard(execution->lock);
+      failed = execution->failed;
+    }
+
+    if (!failed) {
+      for (int consumer : execution->consumers[index]) {
+        if (--execution->waiting[consumer] == 0) {
+          submit_instruction(execution, consumer);
+        }
+      }
+    }
+  }
+
+  lock_guard<mutex> guard(execution->lock);
+
+  if (result == nullptr && !execution->failed) {
+    execution->failed = true;
+    execution->error = error;
+  }
+
+  if (--execution->outstanding == 0) {
+    execution->done.notify_all();
+  }
+}
+
+/**
+ * Submits the instruction with the passed in index to the shared pool.
+ */
+static void submit_instruction(struct parallel_execution *execution, int index) {
+  {
+    lock_guard<mutex> guard(execution->lock);
+    execution->outstanding++;
+  }
+
+  pool_submit(shared_pool(), [execution, index] { run_parallel_instruction(execution, index); });
+}
+
+/**
+ * Executes the plan on the shared pool, so that instructions which do not
+ * depend on each other run at the same time. Waits until every submitted
+ * instruction is done.
+ */
+static void execute_parallel(struct plan *p, struct memo_cache *memo, const vector<string> &keys,
+                             vector<struct value> &values, bool *failed) {
+  struct parallel_execution execution;
+  int size = p->code.size();
+
+  execution.p = p;
+  execution.memo = memo;
+  execution.keys = &keys;
+  execution.values = &values;
+  execution.consumers.resize(size);
+  execution.waiting.reset(new atomic<int>[size]);
+  execution.remaining.reset(new atomic<int>[size]);
+
+  for (int i = 0; i < size; i++) {
+    const struct instruction &ins = p->code[i];
+
+    execution.waiting[i] = 0;
+    execution.remaining[i] = ins.uses;
+
+    // The operands are loaded before the execution starts, so only computed
+    // instructions have to be waited for.
+    for (int operand : {ins.left, ins.right}) {
+      if (operand >= 0 && p->code[operand].op != OP_LOAD) {
+        execution.consumers[operand].push_back(i);
+        execution.waiting[i]++;
+      }
+    }
+  }
+
+  // The ready instructions are all found before any of them is submitted, as
+  // a submitted instruction may finish at once and submit its consumers,
+  // which would then be seen as ready and submitted again.
+  vector<int> ready;
+
+  for (int i = 0; i < size; i++) {
+    if (p->code[i].op != OP_LOAD && execution.waiting[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+
+  for (int index : ready) {
+    submit_instruction(&execution, index);
+  }
+
+  unique_lock<mutex> guard(execution.lock);
+  execution.done.wait(guard, [&execution] { return execution.outstanding == 0; });
+
+  if (execution.failed) {
+    *failed = true;
+
+    if (!execution.error.empty()) {
+      fl_alert("%s", execution.error.c_str());
+    }
+  }
+}
+
+/**
+ * Executes the passed in plan over the matrices of the passed in list. Every
+ * instruction stores its result in its own register, which is freed after the
+ * last instruction using it. Plans with independent subexpressions whose
+ * estimated cost is high enough are executed in parallel. If a memo cache is
+ * passed in, expensive results computed from the same versions of the same
+ * matrices before are reused instead of being recomputed. Returns a newly
+ * allocated matrix holding the result, which the caller owns, or a null
+ * pointer if an operand no longer exists or an operation failed.
+ */
+Matrix* execute_plan(struct matrix_list *l, struct plan *p, struct memo_cache *memo) {
+  vector<struct value> values(p->code.size(), {nullptr, false});
+  bool failed = false;
+
+  p->times.assign(p->code.size(), 0.0);
+
+  if (!load_operands(l, p, values)) {
+    return nullptr;
+  }
+
+  vector<string> keys;
+
+  if (memo != nullptr) {
+    memo_keys(p, values, keys);
+  }
+
+  double estimated = 0.0;
+
+  for (size_t i = 0; i < p->estimates.size(); i++) {
+    estimated += p->estimates[i];
+  }
+
+  if (estimated >= PARALLEL_THRESHOLD && has_independent_work(p)) {
+    execute_parallel(p, memo, keys, values, &failed);
+  } else {
+    execute_serial(p, memo, keys, values, &failed);
+  }
+
+  if (failed) {
+    release_all(values);
+    return nullptr;
+  }
+
+  struct value root = values[p->root];
+
+  // An expression without operators evaluates to one of the operands, so it
+  // is copied in order for the caller to always own the result.
+  if (!root.owned) {
+    Matrix *copy = new Matrix(root.matrix->get_rows(), root.matrix->get_columns());
+    *copy = *root.matrix;
+    return copy;
+  }
+
+  return root.matrix;
+}
@@ -0,0 +1,137 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __PLAN_H_INCLUDED__
+#define __PLAN_H_INCLUDED__
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lexer.h"
+#include "matrix.h"
+#include "matrix_list.h"
+#include "memo_cache.h"
+
+/**
+ * The estimated number of fraction operations above which a plan with
+ * independent subexpressions is executed on the shared pool.
+ */
+#define PARALLEL_THRESHOLD 1000000.0
+
+/**
+ * Enumeration of the instructions understood by the plan interpreter.
+ */
+enum opcode {OP_LOAD, OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_SCALE, OP_TRANSPOSE, OP_RREF, OP_INVERT, OP_DETERMINANT, OP_SOLVE, OP_POWER, OP_CHARPOLY};
+
+/**
+ * Enumeration of the kernels an instruction can be carried out with. The
+ * default kernel is the only one for most instructions, while the planner
+ * chooses between the others by their estimated cost.
+ */
+enum kernel {KERNEL_DEFAULT, KERNEL_NAIVE, KERNEL_BLOCKED, KERNEL_COFACTOR, KERNEL_ELIMINATION};
+
+/**
+ * A single instruction of a compiled plan. The instructions form a directed
+ * acyclic graph: left and right are the indices of the instructions whose
+ * results are consumed, or -1 when unused, and always point to earlier
+ * instructions. For OP_LOAD the argument is the symbol of the operand, for
+ * OP_SCALE it is an index into the numbers of the plan, for OP_POWER it is the
+ * exponent and for every other instruction it is unused. The uses count how many times the result is
+ * consumed, including once by the plan itself if it is the root. The kernel
+ * is chosen by the planner.
+ */
+struct instruction {
+  opcode op;
+  int left;
+  int right;
+  int argument;
+  int uses;
+  kernel method;
+};
+
+/**
+ * The fields identifying an instruction, used to share identical
+ * subexpressions.
+ */
+struct instruction_key {
+  int op;
+  int left;
+  int right;
+  int argument;
+
+  bool operator == (const instruction_key &other) const {
+    return op == other.op && left == other.left && right == other.right && argument == other.argument;
+  }
+};
+
+/**
+ * A hash function for the keys of instructions.
+ */
+struct instruction_key_hash {
+  size_t operator () (const instruction_key &key) const {
+    size_t hash = key.op;
+    hash = hash * 31 + key.left;
+    hash = hash * 31 + key.right;
+    hash = hash * 31 + key.argument;
+    return hash;
+  }
+};
+
+/**
+ * An entry of the register file of the interpreter. The operands of a plan are
+ * borrowed from the matrix list, while the intermediate results are owned by
+ * the interpreter and deleted after their last use, so they never have to be
+ * inserted in the matrix list.
+ */
+struct value {
+  Matrix *matrix;
+  bool owned;
+};
+
+/**
+ * A compiled expression. The matrix names are interned once when the plan is
+ * compiled and the operands are kept as symbols, so executing the plan again
+ * does not touch the expression string and each operand is found in constant
+ * time. Identical subexpressions are compiled into a single instruction,
+ * which the index maps from its key, so each of them is evaluated only once.
+ * The root is the instruction producing the result. The planner fills in the
+ * estimated cost of every instruction and the dimensions of the operands it
+ * was optimised for, as its rewrites and kernels are only right for those, and
+ * the interpreter records the time in seconds each instruction took during the
+ * last execution.
+ */
+struct plan {
+  std::vector<struct instruction> code;
+  std::vector<double> numbers;
+  std::unordered_map<struct instruction_key, int, struct instruction_key_hash> index;
+  int root = -1;
+  std::vector<double> estimates;
+  std::vector<std::pair<int, int> > operand_shapes;
+  std::vector<double> times;
+};
+
+int plan_instruction(struct plan *p, opcode op, int left, int right, int argument);
+int plan_number(struct plan *p, double number);
+void finish_plan(struct plan *p);
+bool compile_plan(struct matrix_list *l, const char *expression, const std::vector<struct token> &postfix, struct plan *p);
+Matrix* execute_plan(struct matrix_list *l, struct plan *p, struct memo_cache *memo);
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <cctype>
+#include "plan_cache.h"
+#include "planner.h"
+
+using namespace std;
+
+/**
+ * Returns the expression without any whitespace, so that expressions which
+ * differ only in spacing share the same plan.
+ */
+string normalise_expression(const char *expression) {
+  string normalised;
+
+  for (const char *current = expression; *current != '\0'; current++) {
+    if (!isspace((int)*current)) {
+      normalised.push_back(*current);
+    }
+  }
+
+  return normalised;
+}
+
+/**
+ * Returns the plan compiled for the passed in normalised expression and marks
+ * it as the most recently used one. Returns a null pointer if there is none or
+ * if the operands in the matrix list no longer have the dimensions the plan
+ * was optimised for, in which case the plan is dropped.
+ */
+struct plan* plan_cache_find(struct plan_cache *c, struct matrix_list *l, const string &expression) {
+  unordered_map<string, plan_cache_iter>::iterator found = c->index.find(expression);
+
+  if (found != c->index.end() && !plan_is_current(l, &found->second->second)) {
+    c->entries.erase(found->second);
+    c->index.erase(found);
+    found = c->index.end();
+  }
+
+  if (found == c->index.end()) {
+    c->misses++;
+    return nullptr;
+  }
+
+  c->hits++;
+
+  c->entries.splice(c->entries.begin(), c->entries, found->second);
+
+  return &found->second->second;
+}
+
+/**
+ * Moves the passed in plan into the cache under the normalised expression and
+ * returns a pointer to the cached copy. If the cache is full, the least
+ * recently used plan is evicted.
+ */
+struct plan* plan_cache_insert(struct plan_cache *c, const string &expression, struct plan *p) {
+  unordered_map<string, plan_cache_iter>::iterator found = c->index.find(expression);
+
+  if (found != c->index.end()) {
+    c->entries.erase(found->second);
+    c->index.erase(found);
+  }
+
+  if (c->capacity > 0 && c->entries.size() >= c->capacity) {
+    c->index.erase(c->entries.back().first);
+    c->entries.pop_back();
+  }
+
+  c->entries.push_front(make_pair(expression, std::move(*p)));
+  c->index[expression] = c->entries.begin();
+
+  return &c->entries.front().second;
+}
+
+/**
+ * Removes every plan from the cache.
+ */
+void plan_cache_clear(struct plan_cache *c) {
+  c->entries.clear();
+  c->index.clear();
+}
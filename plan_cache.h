@@ -0,0 +1,57 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __PLAN_CACHE_H_INCLUDED__
+#define __PLAN_CACHE_H_INCLUDED__
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "matrix_list.h"
+#include "plan.h"
+
+/**
+ * The number of plans kept by the cache used by the calculator.
+ */
+#define PLAN_CACHE_CAPACITY 64
+
+typedef std::list<std::pair<std::string, struct plan> >::iterator plan_cache_iter;
+
+/**
+ * A least recently used cache mapping normalised expressions to their compiled
+ * plans. The entries are ordered from the most to the least recently used one
+ * and the index gives constant time access to them by expression.
+ */
+struct plan_cache {
+  std::list<std::pair<std::string, struct plan> > entries;
+  std::unordered_map<std::string, plan_cache_iter> index;
+  size_t capacity = PLAN_CACHE_CAPACITY;
+  unsigned long hits = 0;
+  unsigned long misses = 0;
+};
+
+std::string normalise_expression(const char *expression);
+struct plan* plan_cache_find(struct plan_cache *c, struct matrix_list *l, const std::string &expression);
+struct plan* plan_cache_insert(struct plan_cache *c, const std::string &expression, struct plan *p);
+void plan_cache_clear(struct plan_cache *c);
+
+#endif
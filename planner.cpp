@@ -0,0 +1,604 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "operations.h"
+#include "planner.h"
+
+using namespace std;
+
+/**
+ * Works out the dimensions of the result of every instruction of the plan from
+ * the dimensions of the matrices currently carrying the names of its operands.
+ */
+void infer_shapes(struct matrix_list *l, struct plan *p, vector<struct shape> *shapes) {
+  shapes->assign(p->code.size(), {-1, -1});
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    const struct instruction &ins = p->code[i];
+    struct shape left = ins.left >= 0 ? (*shapes)[ins.left] : shape {-1, -1};
+    struct shape right = ins.right >= 0 ? (*shapes)[ins.right] : shape {-1, -1};
+    struct shape result = {-1, -1};
+
+    switch (ins.op) {
+      case OP_LOAD: {
+        Matrix *operand = registry_resolve(l, ins.argument);
+        if (operand != nullptr) {
+          result = {operand->get_rows(), operand->get_columns()};
+        }
+        break;
+      }
+      case OP_ADD:
+      case OP_SUBTRACT:
+        if (left.rows == right.rows && left.columns == right.columns) {
+          result = left;
+        }
+        break;
+      case OP_MULTIPLY:
+        if (left.columns >= 0 && left.columns == right.rows) {
+          result = {left.rows, right.columns};
+        }
+        break;
+      case OP_SCALE:
+      case OP_RREF:
+        result = left;
+        break;
+      case OP_INVERT:
+        if (left.rows == left.columns) {
+          result = left;
+        }
+        break;
+      case OP_TRANSPOSE:
+        result = {left.columns, left.rows};
+        break;
+      case OP_DETERMINANT:
+        result = {1, 1};
+        break;
+      case OP_SOLVE:
+        if (left.rows == left.columns && left.rows == right.rows) {
+          result = {left.columns, right.columns};
+        }
+        break;
+      case OP_POWER:
+        if (left.rows == left.columns) {
+          result = left;
+        }
+        break;
+      case OP_CHARPOLY:
+        if (left.rows == left.columns) {
+          result = {1, left.rows + 1};
+        }
+        break;
+    }
+
+    (*shapes)[i] = result;
+  }
+}
+
+/**
+ * Collects the factors of the chain of products ending in the passed in
+ * instruction from left to right. A product whose result is used more than
+ * once is a factor of its own, so that it is still computed only once.
+ */
+static void collect_factors(struct plan *p, int index, vector<int> *factors) {
+  const struct instruction &ins = p->code[index];
+
+  if (ins.op != OP_MULTIPLY) {
+    factors->push_back(index);
+    return;
+  }
+
+  for (int operand : {ins.left, ins.right}) {
+    if (p->code[operand].op == OP_MULTIPLY && p->code[operand].uses == 1) {
+      collect_factors(p, operand, factors);
+    } else {
+      factors->push_back(operand);
+    }
+  }
+}
+
+/**
+ * Returns the number of scalar multiplications needed to evaluate the chain of
+ * products ending in the passed in instruction as it is written, stopping at
+ * the same instructions as collect_factors.
+ */
+static long long written_cost(struct plan *p, const vector<struct shape> &shapes, int index) {
+  const struct instruction &ins = p->code[index];
+  long long cost = (long long) shapes[ins.left].rows * shapes[ins.left].columns * shapes[ins.right].columns;
+
+  for (int operand : {ins.left, ins.right}) {
+    if (p->code[operand].op == OP_MULTIPLY && p->code[operand].uses == 1) {
+      cost += written_cost(p, shapes, operand);
+    }
+  }
+
+  return cost;
+}
+
+/**
+ * Appends the products of factors i to j to the new plan in the order given by
+ * the splits and returns the index of the instruction producing the result.
+ */
+static int build_chain(struct plan *q, const vector<int> &factors, const vector<vector<int> > &split, int i, int j) {
+  if (i == j) {
+    return factors[i];
+  }
+
+  int left = build_chain(q, factors, split, i, split[i][j]);
+  int right = build_chain(q, factors, split, split[i][j] + 1, j);
+
+  return plan_instruction(q, OP_MULTIPLY, left, right, 0);
+}
+
+/**
+ * Reassociates every chain of matrix products in the plan so that it needs the
+ * smallest number of scalar multiplications, using the dynamic programming
+ * algorithm for the matrix chain problem. Matrix multiplication is associative
+ * and the elements are exact fractions, so the result does not change. Chains
+ * whose dimensions are not known or do not match are left as they are. The
+ * plan is copied instruction by instruction and the products inside a
+ * reassociated chain become unused, so finish_plan removes them.
+ */
+void order_products(struct matrix_list *l, struct plan *p) {
+  vector<struct shape> shapes;
+  infer_shapes(l, p, &shapes);
+
+  struct plan q;
+  q.numbers = p->numbers;
+  vector<int> mapped(p->code.size(), -1);
+  bool changed = false;
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    struct instruction ins = p->code[i];
+    int left = ins.left >= 0 ? mapped[ins.left] : -1;
+    int right = ins.right >= 0 ? mapped[ins.right] : -1;
+
+    if (ins.op != OP_MULTIPLY || shapes[i].rows < 0) {
+      mapped[i] = plan_instruction(&q, ins.op, left, right, ins.argument);
+      continue;
+    }
+
+    vector<int> factors;
+    collect_factors(p, i, &factors);
+
+    int n = factors.size();
+
+    // The dimensions of factor k are dimensions[k] by dimensions[k + 1].
+    vector<long long> dimensions(n + 1);
+
+    for (int k = 0; k < n; k++) {
+      dimensions[k] = shapes[factors[k]].rows;
+      factors[k] = mapped[factors[k]];
+    }
+
+    dimensions[n] = shapes[i].columns;
+
+    vector<vector<long long> > cost(n, vector<long long>(n, 0));
+    vector<vector<int> > split(n, vector<int>(n, 0));
+
+    for (int length = 2; length <= n; length++) {
+      for (int a = 0; a + length - 1 < n; a++) {
+        int b = a + length - 1;
+        cost[a][b] = -1;
+
+        for (int k = a; k < b; k++) {
+          long long candidate = cost[a][k] + cost[k + 1][b] + dimensions[a] * dimensions[k + 1] * dimensions[b + 1];
+
+          if (cost[a][b] < 0 || candidate < cost[a][b]) {
+            cost[a][b] = candidate;
+            split[a][b] = k;
+          }
+        }
+      }
+    }
+
+    if (n > 2 && cost[0][n - 1] < written_cost(p, shapes, i)) {
+      mapped[i] = build_chain(&q, factors, split, 0, n - 1);
+      changed = true;
+    } else {
+      mapped[i] = plan_instruction(&q, ins.op, left, right, ins.argument);
+    }
+  }
+
+  if (!changed) {
+    return;
+  }
+
+  q.root = mapped[p->root];
+  finish_plan(&q);
+
+  p->code.swap(q.code);
+  p->index.swap(q.index);
+  p->root = q.root;
+}
+
+/**
+ * Returns the number of elements of a matrix with the passed in dimensions.
+ */
+static long long elements_of(const struct shape &s) {
+  return (long long) s.rows * s.columns;
+}
+
+/**
+ * Returns the instruction producing the transpose of the result of the passed
+ * in instruction, cancelling a transpose which is already there.
+ */
+static int transpose_of(struct plan *q, int index) {
+  if (q->code[index].op == OP_TRANSPOSE) {
+    return q->code[index].left;
+  }
+
+  return plan_instruction(q, OP_TRANSPOSE, index, -1, 0);
+}
+
+/**
+ * Returns the number of elements copied by transpose_of for the passed in
+ * instruction, whose result has the passed in dimensions.
+ */
+static long long transpose_cost(struct plan *q, int index, const struct shape &s) {
+  return q->code[index].op == OP_TRANSPOSE ? 0 : elements_of(s);
+}
+
+/**
+ * Checks whether the passed in dimensions belong to a square matrix.
+ */
+static bool is_square(const struct shape &s) {
+  return s.rows >= 0 && s.rows == s.columns;
+}
+
+/**
+ * Rewrites the plan using identities which give the same result for less
+ * work:
+ * X|| becomes X and X&& becomes X, when X is square,
+ * (A*B)| becomes B|*A| when transposing the factors copies fewer elements,
+ * #(A|) becomes #A and #(A*B) becomes #A*#B, when A and B are square,
+ * %(A|) becomes %A,
+ * c*(A*B) becomes (c*A)*B or A*(c*B), whichever scales the fewest elements.
+ * A product is only taken apart when its result is not used anywhere else, as
+ * otherwise it would still have to be computed. Note that X&& no longer
+ * reports a singular X.
+ */
+void rewrite_plan(struct matrix_list *l, struct plan *p) {
+  vector<struct shape> shapes;
+  infer_shapes(l, p, &shapes);
+
+  struct plan q;
+  q.numbers = p->numbers;
+  vector<int> mapped(p->code.size(), -1);
+  bool changed = false;
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    struct instruction ins = p->code[i];
+    int result = -1;
+
+    if (ins.left >= 0) {
+      // The patterns are matched against the original plan, while the
+      // replacements are built from the already rewritten operands.
+      struct instruction inner = p->code[ins.left];
+      bool single = inner.uses == 1;
+      int a = inner.left >= 0 ? mapped[inner.left] : -1;
+      int b = inner.right >= 0 ? mapped[inner.right] : -1;
+
+      switch (ins.op) {
+        case OP_TRANSPOSE:
+          if (inner.op == OP_TRANSPOSE) {
+            result = a;
+          } else if (inner.op == OP_MULTIPLY && single && shapes[ins.left].rows >= 0) {
+            long long factors_cost = transpose_cost(&q, a, shapes[inner.left]) + transpose_cost(&q, b, shapes[inner.right]);
+
+            if (factors_cost < elements_of(shapes[ins.left])) {
+              int transposed_b = transpose_of(&q, b);
+              int transposed_a = transpose_of(&q, a);
+              result = plan_instruction(&q, OP_MULTIPLY, transposed_b, transposed_a, 0);
+            }
+          }
+          break;
+        case OP_INVERT:
+          if (inner.op == OP_INVERT && is_square(shapes[inner.left])) {
+            result = a;
+          }
+          break;
+        case OP_DETERMINANT:
+          if (inner.op == OP_TRANSPOSE) {
+            result = plan_instruction(&q, OP_DETERMINANT, a, -1, 0);
+          } else if (inner.op == OP_MULTIPLY && single && shapes[ins.left].rows >= 0
+                     && is_square(shapes[inner.left]) && is_square(shapes[inner.right])) {
+            // The product has to be valid, as two square factors of different
+            // sizes have determinants but no product.
+            int determinant_a = plan_instruction(&q, OP_DETERMINANT, a, -1, 0);
+            int determinant_b = plan_instruction(&q, OP_DETERMINANT, b, -1, 0);
+            result = plan_instruction(&q, OP_MULTIPLY, determinant_a, determinant_b, 0);
+          }
+          break;
+        case OP_CHARPOLY:
+          if (inner.op == OP_TRANSPOSE) {
+            result = plan_instruction(&q, OP_CHARPOLY, a, -1, 0);
+          }
+          break;
+        case OP_SCALE:
+          if (inner.op == OP_MULTIPLY && single && shapes[ins.left].rows >= 0) {
+            long long elements_a = elements_of(shapes[inner.left]);
+            long long elements_b = elements_of(shapes[inner.right]);
+            long long elements_result = elements_of(shapes[ins.left]);
+
+            if (elements_a <= elements_b && elements_a < elements_result) {
+              int scaled = plan_instruction(&q, OP_SCALE, a, -1, ins.argument);
+              result = plan_instruction(&q, OP_MULTIPLY, scaled, b, 0);
+            } else if (elements_b < elements_a && elements_b < elements_result) {
+              int scaled = plan_instruction(&q, OP_SCALE, b, -1, ins.argument);
+              result = plan_instruction(&q, OP_MULTIPLY, a, scaled, 0);
+            }
+          }
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (result >= 0) {
+      changed = true;
+    } else {
+      int left = ins.left >= 0 ? mapped[ins.left] : -1;
+      int right = ins.right >= 0 ? mapped[ins.right] : -1;
+      result = plan_instruction(&q, ins.op, left, right, ins.argument);
+    }
+
+    mapped[i] = result;
+  }
+
+  if (!changed) {
+    return;
+  }
+
+  q.root = mapped[p->root];
+  finish_plan(&q);
+
+  p->code.swap(q.code);
+  p->index.swap(q.index);
+  p->root = q.root;
+}
+
+/**
+ * Returns the estimated number of fraction operations the passed in
+ * instruction takes with the passed in kernel and argument, given the
+ * dimensions of its operands and result. Returns zero when the dimensions are
+ * not known.
+ */
+static double estimate_cost(opcode op, kernel method, int argument, const struct shape &left, const struct shape &right,
+                            const struct shape &result) {
+  double rows = left.rows;
+  double columns = left.columns;
+
+  if (left.rows < 0 || result.rows < 0) {
+    return 0.0;
+  }
+
+  switch (op) {
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_SCALE:
+    case OP_TRANSPOSE:
+      return rows * columns;
+    case OP_MULTIPLY: {
+      double operations = rows * columns * right.columns;
+      // The blocked kernel walks the same elements, but keeps them in the
+      // cache once the matrices stop fitting there.
+      if (method == KERNEL_BLOCKED) {
+        return operations * BLOCKED_SPEEDUP;
+      }
+      return operations;
+    }
+    case OP_RREF:
+      return rows * columns * min(rows, columns);
+    case OP_INVERT:
+      // The singularity check and the reduced row echelon form of the matrix
+      // augmented with the identity matrix.
+      return rows * rows * rows / 3.0 + 2.0 * rows * rows * rows;
+    case OP_DETERMINANT: {
+      if (method == KERNEL_ELIMINATION) {
+        return rows * rows * rows / 3.0;
+      }
+      // The cofactor expansion takes n! products.
+      double operations = 1.0;
+      for (int i = 2; i <= left.rows; i++) {
+        operations *= i;
+      }
+      return operations;
+    }
+    case OP_SOLVE:
+      // The factorisation and a substitution for every column of the right
+      // hand side.
+      return rows * rows * rows / 3.0 + rows * rows * right.columns;
+    case OP_POWER: {
+      // A squaring for every bit of the exponent after the first and a product
+      // for every set bit after the first, after an inversion for a negative
+      // exponent.
+      unsigned int exponent = argument < 0 ? -argument : argument;
+      int products = -1;
+      double operations = argument < 0 ? rows * rows * rows / 3.0 + 2.0 * rows * rows * rows : 0.0;
+
+      for (; exponent > 0; exponent >>= 1) {
+        products += (exponent & 1) + (exponent > 1 ? 1 : 0);
+      }
+
+      return operations + max(products, 0) * rows * rows * rows;
+    }
+    case OP_CHARPOLY:
+      // Every leading submatrix of size k takes k products with the one before
+      // it, each of them needing k^2 operations.
+      return rows * rows * rows * rows / 4.0;
+    default:
+      return 0.0;
+  }
+}
+
+/**
+ * Chooses the cheapest kernel for every instruction of the plan according to
+ * the estimated number of operations and records the estimates.
+ */
+void choose_kernels(struct matrix_list *l, struct plan *p) {
+  vector<struct shape> shapes;
+  infer_shapes(l, p, &shapes);
+
+  p->estimates.assign(p->code.size(), 0.0);
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    struct instruction *ins = &p->code[i];
+    struct shape none = {-1, -1};
+    struct shape left = ins->left >= 0 ? shapes[ins->left] : none;
+    struct shape right = ins->right >= 0 ? shapes[ins->right] : none;
+    vector<kernel> candidates;
+
+    switch (ins->op) {
+      case OP_MULTIPLY:
+        candidates = {KERNEL_NAIVE, KERNEL_BLOCKED};
+        // Blocking only pays off once a block no longer covers the matrices.
+        if (left.rows <= BLOCK_SIZE && left.columns <= BLOCK_SIZE && right.columns <= BLOCK_SIZE) {
+          candidates = {KERNEL_NAIVE};
+        }
+        break;
+      case OP_DETERMINANT:
+        candidates = {KERNEL_COFACTOR, KERNEL_ELIMINATION};
+        break;
+      default:
+        candidates = {KERNEL_DEFAULT};
+        break;
+    }
+
+    ins->method = candidates[0];
+    p->estimates[i] = estimate_cost(ins->op, candidates[0], ins->argument, left, right, shapes[i]);
+
+    for (size_t k = 1; k < candidates.size(); k++) {
+      double cost = estimate_cost(ins->op, candidates[k], ins->argument, left, right, shapes[i]);
+
+      if (cost < p->estimates[i]) {
+        ins->method = candidates[k];
+        p->estimates[i] = cost;
+      }
+    }
+  }
+}
+
+/**
+ * Returns a description of the plan listing for every instruction its
+ * operands, the dimensions of its result, the chosen kernel, the estimated
+ * time and the time it took during the last execution.
+ */
+string explain_plan(struct matrix_list *l, struct plan *p) {
+  const char *operations[] = {"load", "add", "subtract", "multiply", "scale", "transpose", "rref", "invert", "determinant", "solve", "power", "charpoly"};
+  const char *kernels[] = {"default", "naive", "blocked", "cofactor", "elimination"};
+
+  vector<struct shape> shapes;
+  infer_shapes(l, p, &shapes);
+
+  ostringstream os;
+  double estimated_total = 0.0;
+  double actual_total = 0.0;
+
+  os << fixed << setprecision(3);
+  os << "  #  operation    arguments  result     kernel       est. ms   actual ms\n";
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    const struct instruction &ins = p->code[i];
+    ostringstream arguments;
+    ostringstream dimensions;
+
+    if (ins.op == OP_LOAD) {
+      arguments << l->symbols[ins.argument];
+    } else {
+      arguments << ins.left;
+      if (ins.right >= 0) {
+        arguments << "," << ins.right;
+      }
+      if (ins.op == OP_SCALE) {
+        arguments << "," << p->numbers[ins.argument];
+      } else if (ins.op == OP_POWER) {
+        arguments << "," << ins.argument;
+      }
+    }
+
+    dimensions << shapes[i].rows << "x" << shapes[i].columns;
+
+    double estimated = i < p->estimates.size() ? p->estimates[i] * NANOSECONDS_PER_OPERATION / 1e6 : 0.0;
+    double actual = i < p->times.size() ? p->times[i] * 1e3 : 0.0;
+
+    estimated_total += estimated;
+    actual_total += actual;
+
+    os << setw(3) << i << "  " << left << setw(12) << operations[ins.op] << " " << setw(10) << arguments.str()
+       << " " << setw(10) << dimensions.str() << " " << setw(12) << kernels[ins.method] << right
+       << setw(8) << estimated << "  " << setw(10) << actual << "\n";
+  }
+
+  os << "total" << setw(55) << estimated_total << "  " << setw(10) << actual_total << "\n";
+
+  return os.str();
+}
+
+/**
+ * Collects the dimensions of the matrices currently carrying the names of the
+ * operands of the plan, in the order of their instructions. A missing operand
+ * has the dimensions -1 by -1.
+ */
+static void operand_shapes(struct matrix_list *l, struct plan *p, vector<pair<int, int> > *shapes) {
+  shapes->clear();
+
+  for (size_t i = 0; i < p->code.size(); i++) {
+    if (p->code[i].op != OP_LOAD) {
+      continue;
+    }
+
+    Matrix *operand = registry_resolve(l, p->code[i].argument);
+
+    if (operand == nullptr) {
+      shapes->push_back(make_pair(-1, -1));
+    } else {
+      shapes->push_back(make_pair(operand->get_rows(), operand->get_columns()));
+    }
+  }
+}
+
+/**
+ * Runs the optimisation passes over a freshly compiled plan. The rewrites run
+ * first, because they can create new chains of products, and the kernels are
+ * chosen once the shape of the plan is settled. The dimensions of the operands
+ * are recorded, so that plan_is_current can tell when they change.
+ */
+void optimise_plan(struct matrix_list *l, struct plan *p) {
+  rewrite_plan(l, p);
+  order_products(l, p);
+  choose_kernels(l, p);
+  operand_shapes(l, p, &p->operand_shapes);
+}
+
+/**
+ * Checks whether the operands of an optimised plan still have the dimensions it
+ * was optimised for. If they do not, the rewrites and kernels may be wrong or
+ * slow for them and the expression has to be planned again.
+ */
+bool plan_is_current(struct matrix_list *l, struct plan *p) {
+  vector<pair<int, int> > shapes;
+  operand_shapes(l, p, &shapes);
+
+  return shapes == p->operand_shapes;
+}
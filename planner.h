@@ -0,0 +1,60 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __PLANNER_H_INCLUDED__
+#define __PLANNER_H_INCLUDED__
+
+#include <string>
+#include <vector>
+#include "matrix_list.h"
+#include "plan.h"
+
+/**
+ * The estimated time a single fraction operation takes, used to turn the
+ * estimated number of operations into an estimated time.
+ */
+#define NANOSECONDS_PER_OPERATION 40.0
+
+/**
+ * The estimated fraction of the time of the naive product taken by the
+ * blocked product on matrices which do not fit in a block.
+ */
+#define BLOCKED_SPEEDUP 0.8
+
+/**
+ * The dimensions of the result of an instruction. Both are -1 when they cannot
+ * be determined, for example because the dimensions of the operands of an
+ * addition do not match.
+ */
+struct shape {
+  int rows;
+  int columns;
+};
+
+void infer_shapes(struct matrix_list *l, struct plan *p, std::vector<struct shape> *shapes);
+void rewrite_plan(struct matrix_list *l, struct plan *p);
+void order_products(struct matrix_list *l, struct plan *p);
+void choose_kernels(struct matrix_list *l, struct plan *p);
+std::string explain_plan(struct matrix_list *l, struct plan *p);
+void optimise_plan(struct matrix_list *l, struct plan *p);
+bool plan_is_current(struct matrix_list *l, struct plan *p);
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include "pool.h"
+
+using namespace std;
+
+/**
+ * The pool the current thread works for and its index in that pool, or a null
+ * pointer and -1 for threads outside any pool.
+ */
+static thread_local struct work_pool *current_pool = nullptr;
+static thread_local int current_worker = -1;
+
+/**
+ * The pool shared by the whole calculator, created on first use, and the lock
+ * guarding its creation, as eliminations on the workers use it as well.
+ */
+static struct work_pool *shared = nullptr;
+static mutex shared_lock;
+
+/**
+ * Takes a task for the worker with the passed in index, first from the back of
+ * its own queue and then from the front of the queues of the other workers.
+ * Returns false if every queue is empty.
+ */
+static bool take_task(struct work_pool *pool, int index, function<void()> *task) {
+  int count = pool->queues.size();
+
+  for (int i = 0; i < count; i++) {
+    struct work_queue *queue = pool->queues[(index + i) % count].get();
+    lock_guard<mutex> guard(queue->lock);
+
+    if (queue->tasks.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      *task = std::move(queue->tasks.back());
+      queue->tasks.pop_back();
+    } else {
+      *task = std::move(queue->tasks.front());
+      queue->tasks.pop_front();
+    }
+
+    pool->queued--;
+
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * The loop run by every worker. It carries out tasks until the pool is
+ * destroyed and sleeps while there are none.
+ */
+static void worker_loop(struct work_pool *pool, int index) {
+  current_pool = pool;
+  current_worker = index;
+
+  while (true) {
+    function<void()> task;
+
+    if (take_task(pool, index, &task)) {
+      task();
+      continue;
+    }
+
+    unique_lock<mutex> guard(pool->sleep_lock);
+
+    pool->wake.wait(guard, [pool] { return pool->stopping || pool->queued > 0; });
+
+    if (pool->stopping) {
+      return;
+    }
+  }
+}
+
+/**
+ * Starts the passed in number of workers.
+ */
+void pool_init(struct work_pool *pool, int threads) {
+  pool->queued = 0;
+  pool->next_queue = 0;
+  pool->stopping = false;
+
+  for (int i = 0; i < threads; i++) {
+    pool->queues.push_back(unique_ptr<struct work_queue>(new work_queue));
+  }
+
+  for (int i = 0; i < threads; i++) {
+    pool->workers.push_back(thread(worker_loop, pool, i));
+  }
+}
+
+/**
+ * Adds a task to the pool and wakes up a worker to carry it out.
+ */
+void pool_submit(struct work_pool *pool, function<void()> task) {
+  int index;
+
+  if (current_pool == pool) {
+    index = current_worker;
+  } else {
+    index = pool->next_queue++ % pool->queues.size();
+  }
+
+  {
+    lock_guard<mutex> guard(pool->queues[index]->lock);
+    pool->queues[index]->tasks.push_back(std::move(task));
+  }
+
+  {
+    // Taking the lock makes sure a worker about to sleep sees the new task.
+    lock_guard<mutex> guard(pool->sleep_lock);
+    pool->queued++;
+  }
+
+  pool->wake.notify_one();
+}
+
+/**
+ * The progress of a pool_parallel_for call, shared with the tasks helping it.
+ * A helper may only start after the call returned, so it owns the state
+ * together with the caller.
+ */
+struct range_state {
+  std::function<void(int, int)> body;
+  int begin;
+  int end;
+  int grain;
+  int chunks;
+  atomic<int> next;
+  atomic<int> done;
+  mutex lock;
+  condition_variable finished;
+};
+
+/**
+ * Calls the body of the passed in state on chunks of its range until there are
+ * none left to take.
+ */
+static void run_chunks(const shared_ptr<struct range_state> &state) {
+  int chunk;
+
+  while ((chunk = state->next++) < state->chunks) {
+    int from = state->begin + chunk * state->grain;
+
+    state->body(from, min(state->end, from + state->grain));
+
+    if (++state->done == state->chunks) {
+      lock_guard<mutex> guard(state->lock);
+      state->finished.notify_all();
+    }
+  }
+}
+
+/**
+ * Calls body on consecutive ranges of at most grain indices which together
+ * cover [begin, end), on the workers of the pool and the calling thread at the
+ * same time. Returns once every range is done. As the calling thread takes
+ * ranges as well and only waits for ranges which are already running, it may
+ * itself be a worker of the pool.
+ */
+void pool_parallel_for(struct work_pool *pool, int begin, int end, int grain,
+                       const function<void(int, int)> &body) {
+  int chunks = (end - begin + grain - 1) / grain;
+
+  if (chunks <= 1) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+
+  shared_ptr<struct range_state> state = make_shared<range_state>();
+
+  state->body = body;
+  state->begin = begin;
+  state->end = end;
+  state->grain = grain;
+  state->chunks = chunks;
+  state->next = 0;
+  state->done = 0;
+
+  int helpers = min(chunks - 1, (int) pool->workers.size());
+
+  for (int i = 0; i < helpers; i++) {
+    pool_submit(pool, [state] { run_chunks(state); });
+  }
+
+  run_chunks(state);
+
+  unique_lock<mutex> guard(state->lock);
+  state->finished.wait(guard, [&state] { return state->done == state->chunks; });
+}
+
+/**
+ * Stops the workers once they finish their current tasks and waits for them.
+ * Tasks still queued are dropped.
+ */
+void pool_destroy(struct work_pool *pool) {
+  {
+    lock_guard<mutex> guard(pool->sleep_lock);
+    pool->stopping = true;
+  }
+
+  pool->wake.notify_all();
+
+  for (size_t i = 0; i < pool->workers.size(); i++) {
+    pool->workers[i].join();
+  }
+
+  pool->workers.clear();
+  pool->queues.clear();
+}
+
+/**
+ * Returns the pool shared by the calculator, starting one worker per hardware
+ * thread the first time it is called.
+ */
+struct work_pool* shared_pool(void) {
+  lock_guard<mutex> guard(shared_lock);
+
+  if (shared == nullptr) {
+    int threads = thread::hardware_concurrency();
+
+    shared = new work_pool;
+    pool_init(shared, threads > 1 ? threads : 2);
+  }
+
+  return shared;
+}
+
+/**
+ * Stops the shared pool if it was started.
+ */
+void shared_pool_destroy(void) {
+  lock_guard<mutex> guard(shared_lock);
+
+  if (shared != nullptr) {
+    pool_destroy(shared);
+    delete shared;
+    shared = nullptr;
+  }
+}
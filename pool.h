@@ -0,0 +1,66 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __POOL_H_INCLUDED__
+#define __POOL_H_INCLUDED__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The queue of tasks belonging to one worker.
+ */
+struct work_queue {
+  std::mutex lock;
+  std::deque<std::function<void()> > tasks;
+};
+
+/**
+ * A pool of worker threads with a queue each. A worker takes the most recently
+ * added task from its own queue and, when that is empty, steals the oldest task
+ * from the queue of another worker. Tasks submitted by a worker go to its own
+ * queue, while tasks submitted from outside are spread over all queues.
+ */
+struct work_pool {
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<struct work_queue> > queues;
+  std::mutex sleep_lock;
+  std::condition_variable wake;
+  std::atomic<int> queued;
+  std::atomic<unsigned> next_queue;
+  bool stopping = false;
+};
+
+void pool_init(struct work_pool *pool, int threads);
+void pool_submit(struct work_pool *pool, std::function<void()> task);
+void pool_parallel_for(struct work_pool *pool, int begin, int end, int grain,
+                       const std::function<void(int, int)> &body);
+void pool_destroy(struct work_pool *pool);
+struct work_pool* shared_pool(void);
+void shared_pool_destroy(void);
+
+#endif
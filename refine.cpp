@@ -0,0 +1,449 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "pool.h"
+#include "refine.h"
+
+using namespace std;
+
+/**
+ * A 128-bit integer, wide enough for the residuals and the scaled solutions of
+ * the refinement.
+ */
+__extension__ typedef __int128 wide;
+
+/**
+ * The largest magnitude a scaled solution may reach before the next step of
+ * the refinement would overflow it.
+ */
+static const wide WIDE_LIMIT = (wide) 1 << (126 - REFINE_BITS);
+
+/**
+ * The system AX = B with every row multiplied by the least common multiple of
+ * its denominators, so that all its elements are integers. The elements of A
+ * fit in an int and those of B in a long long. Both are stored row by row.
+ */
+struct integer_system {
+  int n;
+  int k;
+  vector<long long> a;
+  vector<long long> b;
+};
+
+/**
+ * The factorisation PA = LU of the integer matrix in double precision, with L
+ * and U stored in lu as by lu_factorise.
+ */
+struct double_lu {
+  int n;
+  vector<double> lu;
+  vector<int> permutation;
+};
+
+static wide absolute(wide x) {
+  return x < 0 ? -x : x;
+}
+
+static wide gcd(wide a, wide b) {
+  a = absolute(a);
+  b = absolute(b);
+
+  while (b != 0) {
+    wide t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return a;
+}
+
+/**
+ * Scales every row of AX = B to integers. Returns false if a scaled element
+ * is too large.
+ */
+static bool make_integer(Matrix *a, Matrix *b, struct integer_system *s) {
+  int n = a->get_rows();
+  int k = b->get_columns();
+
+  s->n = n;
+  s->k = k;
+  s->a.resize(n * n);
+  s->b.resize(n * k);
+
+  for (int i = 0; i < n; i++) {
+    wide scale = 1;
+
+    for (int j = 0; j < n + k; j++) {
+      const Fraction &f = j < n ? a->elements[i * n + j] : b->elements[i * k + j - n];
+
+      scale = scale / gcd(scale, f[1]) * f[1];
+
+      if (scale > INT_MAX) {
+        return false;
+      }
+    }
+
+    for (int j = 0; j < n + k; j++) {
+      const Fraction &f = j < n ? a->elements[i * n + j] : b->elements[i * k + j - n];
+      wide scaled = (wide) f[0] * (scale / f[1]);
+
+      if (j < n) {
+        if (absolute(scaled) > INT_MAX) {
+          return false;
+        }
+
+        s->a[i * n + j] = (long long) scaled;
+      } else {
+        s->b[i * k + j - n] = (long long) scaled;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Factorises the integer matrix in double precision with partial pivoting.
+ * Returns false if it is found to be singular.
+ */
+static bool factorise_double(const struct integer_system &s, struct double_lu *f) {
+  int n = s.n;
+
+  f->n = n;
+  f->lu.assign(s.a.begin(), s.a.end());
+  f->permutation.resize(n);
+
+  for (int i = 0; i < n; i++) {
+    f->permutation[i] = i;
+  }
+
+  double *lu = f->lu.data();
+
+  for (int c = 0; c < n; c++) {
+    int p = c;
+
+    for (int r = c + 1; r < n; r++) {
+      if (fabs(lu[r * n + c]) > fabs(lu[p * n + c])) {
+        p = r;
+      }
+    }
+
+    if (lu[p * n + c] == 0.0) {
+      return false;
+    }
+
+    if (p != c) {
+      swap_ranges(lu + p * n, lu + (p + 1) * n, lu + c * n);
+      swap(f->permutation[p], f->permutation[c]);
+    }
+
+    for (int r = c + 1; r < n; r++) {
+      double factor = lu[r * n + c] / lu[c * n + c];
+
+      lu[r * n + c] = factor;
+
+      if (factor == 0.0) {
+        continue;
+      }
+
+      for (int j = c + 1; j < n; j++) {
+        lu[r * n + j] -= factor * lu[c * n + j];
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Solves Ax = r approximately with the double precision factorisation.
+ */
+static void solve_double(const struct double_lu &f, const vector<wide> &r, vector<double> &x) {
+  int n = f.n;
+  const double *lu = f.lu.data();
+
+  for (int i = 0; i < n; i++) {
+    double sum = (double) r[f.permutation[i]];
+
+    for (int j = 0; j < i; j++) {
+      sum -= lu[i * n + j] * x[j];
+    }
+
+    x[i] = sum;
+  }
+
+  for (int i = n - 1; i >= 0; i--) {
+    double sum = x[i];
+
+    for (int j = i + 1; j < n; j++) {
+      sum -= lu[i * n + j] * x[j];
+    }
+
+    x[i] = sum / lu[i * n + i];
+  }
+}
+
+/**
+ * Finds the fraction p/q closest to numerator/denominator with q at most
+ * limit, which is the last convergent of its continued fraction within the
+ * limit. Returns false if p does not fit in an int.
+ */
+static bool reconstruct(wide numerator, wide denominator, wide limit, int *p, int *q) {
+  wide rest = absolute(numerator);
+  wide previous_p = 0;
+  wide previous_q = 1;
+  wide current_p = 1;
+  wide current_q = 0;
+
+  while (denominator != 0) {
+    wide whole = rest / denominator;
+    wide next_q = whole * current_q + previous_q;
+
+    if (next_q > limit) {
+      break;
+    }
+
+    wide next_p = whole * current_p + previous_p;
+    wide remainder = rest % denominator;
+
+    previous_p = current_p;
+    previous_q = current_q;
+    current_p = next_p;
+    current_q = next_q;
+    rest = denominator;
+    denominator = remainder;
+  }
+
+  if (current_q == 0 || current_p > INT_MAX) {
+    return false;
+  }
+
+  *p = (int) (numerator < 0 ? -current_p : current_p);
+  *q = (int) current_q;
+
+  return true;
+}
+
+/**
+ * Checks exactly that the fractions p/q solve the passed in column of the
+ * integer system, by clearing their denominators. Returns false if they do
+ * not or the check would overflow.
+ */
+static bool verify(const struct integer_system &s, int column, const vector<int> &p, const vector<int> &q) {
+  int n = s.n;
+  wide common = 1;
+
+  for (int j = 0; j < n; j++) {
+    common = common / gcd(common, q[j]) * q[j];
+
+    if (common > LLONG_MAX) {
+      return false;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    wide sum = 0;
+    wide term;
+
+    for (int j = 0; j < n; j++) {
+      if (__builtin_mul_overflow((wide) s.a[i * n + j] * p[j], common / q[j], &term)
+          || __builtin_add_overflow(sum, term, &sum)) {
+        return false;
+      }
+    }
+
+    if (__builtin_mul_overflow((wide) s.b[i * s.k + column], common, &term) || sum != term) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Solves the passed in column of the integer system by iterative refinement.
+ * Every step solves A y = r in double precision, keeps REFINE_BITS bits of y
+ * as integers in the scaled solution and replaces r by the exact residual
+ * 2^REFINE_BITS r - A y, so that after t steps x = N / 2^(t REFINE_BITS) up to
+ * an error which shrinks geometrically. The fractions are then recovered from
+ * N by rational reconstruction and checked exactly. Returns false if the
+ * refinement does not converge or the result cannot be confirmed.
+ */
+static bool refine_column(const struct integer_system &s, const struct double_lu &f, int column,
+                          Fraction *x, unsigned long *steps) {
+  int n = s.n;
+  int k = s.k;
+  wide scale = (wide) 1 << REFINE_BITS;
+  wide denominator = 1;
+  vector<wide> r(n);
+  vector<wide> scaled(n, 0);
+  vector<wide> correction(n);
+  vector<double> y(n);
+  vector<int> p(n);
+  vector<int> q(n);
+
+  for (int i = 0; i < n; i++) {
+    r[i] = s.b[i * k + column];
+  }
+
+  for (int step = 0; ; step++) {
+    wide before = 0;
+
+    for (int i = 0; i < n; i++) {
+      before = max(before, absolute(r[i]));
+    }
+
+    // The residual is zero, so the scaled solution is exact.
+    if (before == 0) {
+      for (int i = 0; i < n; i++) {
+        wide divisor = gcd(scaled[i], denominator);
+
+        if (absolute(scaled[i] / divisor) > INT_MAX || denominator / divisor > INT_MAX) {
+          return false;
+        }
+
+        x[i * k] = Fraction ((int) (scaled[i] / divisor), (int) (denominator / divisor));
+      }
+
+      return true;
+    }
+
+    if (step == REFINE_MAX_STEPS) {
+      return false;
+    }
+
+    solve_double(f, r, y);
+
+    for (int i = 0; i < n; i++) {
+      double part = ldexp(y[i], REFINE_BITS);
+
+      if (!(fabs(part) < ldexp(1.0, 62)) || absolute(scaled[i]) >= WIDE_LIMIT) {
+        return false;
+      }
+
+      correction[i] = (wide) llround(part);
+      scaled[i] = scaled[i] * scale + correction[i];
+    }
+
+    denominator *= scale;
+    (*steps)++;
+
+    wide after = 0;
+
+    for (int i = 0; i < n; i++) {
+      wide sum = r[i] * scale;
+
+      for (int j = 0; j < n; j++) {
+        sum -= s.a[i * n + j] * correction[j];
+      }
+
+      r[i] = sum;
+      after = max(after, absolute(sum));
+    }
+
+    // Every step has to gain at least two bits, or the factorisation is not
+    // accurate enough for the matrix.
+    if (after > before * (scale / 4)) {
+      return false;
+    }
+
+    if (after == 0) {
+      continue;
+    }
+
+    // The reconstruction can only find denominators up to the square root of
+    // the scale reached so far.
+    wide limit = (wide) sqrt((double) denominator / 2.0);
+    bool found = limit > 0;
+
+    if (limit > INT_MAX) {
+      limit = INT_MAX;
+    }
+
+    for (int i = 0; i < n && found; i++) {
+      found = reconstruct(scaled[i], denominator, limit, &p[i], &q[i]);
+    }
+
+    if (found && verify(s, column, p, q)) {
+      for (int i = 0; i < n; i++) {
+        x[i * k] = Fraction (p[i], q[i]);
+      }
+
+      return true;
+    }
+  }
+}
+
+/**
+ * Solves AX = B exactly for a square A by mixed precision iterative
+ * refinement: A is factorised once in double precision and the exact answer is
+ * reconstructed from residuals computed in integer arithmetic, which takes far
+ * fewer fraction operations than an exact elimination for well-conditioned
+ * systems. The columns of B are refined at the same time. Adds the refinement
+ * steps taken to steps. Returns a null pointer without alerting the user if
+ * the system is too badly conditioned, has too large elements or is singular,
+ * so that it is solved by an exact elimination instead.
+ */
+Matrix* refine_solve(Matrix *a, Matrix *b, unsigned long *steps) {
+  struct integer_system s;
+  struct double_lu f;
+
+  if (!make_integer(a, b, &s) || !factorise_double(s, &f)) {
+    return nullptr;
+  }
+
+  Matrix *x = new Matrix(s.n, s.k);
+  atomic<bool> failed(false);
+  atomic<unsigned long> taken(0);
+
+  function<void(int, int)> columns = [&](int from, int to) {
+    unsigned long counted = 0;
+
+    for (int j = from; j < to && !failed; j++) {
+      if (!refine_column(s, f, j, x->elements + j, &counted)) {
+        failed = true;
+      }
+    }
+
+    taken += counted;
+  };
+
+  if (s.k > 1) {
+    pool_parallel_for(shared_pool(), 0, s.k, 1, columns);
+  } else {
+    columns(0, s.k);
+  }
+
+  *steps += taken;
+
+  if (failed) {
+    delete x;
+    return nullptr;
+  }
+
+  return x;
+}
@@ -0,0 +1,646 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include "lu.h"
+#include "operations.h"
+#include "refine.h"
+#include "solver.h"
+#include "sparse.h"
+#include "structure.h"
+
+using namespace std;
+
+/**
+ * A matrix in compressed sparse row form with its elements as doubles, which
+ * the iterative methods work on.
+ */
+struct csr_double {
+  int n;
+  vector<int> row_start;
+  vector<int> column_index;
+  vector<double> values;
+};
+
+/**
+ * The preconditioner M of an iterative solve. The Jacobi preconditioner keeps
+ * the inverse of the diagonal, while ILU(0) keeps the incomplete factors L and
+ * U in the pattern of the matrix, with the position of the diagonal of every
+ * row.
+ */
+struct preconditioner_state {
+  enum preconditioner kind;
+  vector<double> inverse_diagonal;
+  struct csr_double factors;
+  vector<int> diagonal;
+};
+
+/**
+ * The method used by new solves and the statistics gathered since they were
+ * last taken.
+ */
+static atomic<int> current_method(SOLVE_DIRECT);
+static atomic<int> current_preconditioner(PRECONDITION_NONE);
+static mutex statistics_lock;
+static struct solve_statistics statistics = {0, 0, 0.0, 0};
+
+/**
+ * Sets the method and the preconditioner used by the solves from now on.
+ */
+void solve_set_method(enum solve_method method, enum preconditioner preconditioner) {
+  current_method = method;
+  current_preconditioner = preconditioner;
+}
+
+/**
+ * Returns the method used by new solves.
+ */
+enum solve_method solve_get_method(void) {
+  return (enum solve_method) current_method.load();
+}
+
+/**
+ * Returns the preconditioner used by new iterative solves.
+ */
+enum preconditioner solve_get_preconditioner(void) {
+  return (enum preconditioner) current_preconditioner.load();
+}
+
+/**
+ * Returns the name of the passed in solve method as shown to the user.
+ */
+const char* solve_method_name(enum solve_method method) {
+  switch (method) {
+    case SOLVE_REFINED:
+      return "refined";
+    case SOLVE_CG:
+      return "CG";
+    case SOLVE_GMRES:
+      return "GMRES";
+    default:
+      return "direct";
+  }
+}
+
+/**
+ * Returns the name of the passed in preconditioner as shown to the user.
+ */
+const char* preconditioner_name(enum preconditioner preconditioner) {
+  switch (preconditioner) {
+    case PRECONDITION_JACOBI:
+      return "Jacobi";
+    case PRECONDITION_ILU0:
+      return "ILU(0)";
+    default:
+      return "none";
+  }
+}
+
+/**
+ * Returns the statistics gathered since they were last taken and starts
+ * gathering them anew.
+ */
+struct solve_statistics solve_take_statistics(void) {
+  lock_guard<mutex> guard(statistics_lock);
+  struct solve_statistics taken = statistics;
+
+  statistics = {0, 0, 0.0, 0};
+
+  return taken;
+}
+
+/**
+ * Converts a fraction to the nearest double.
+ */
+static double to_double(const Fraction &f) {
+  return (double) f[0] / (double) f[1];
+}
+
+/**
+ * Rounds a double to the closest fraction with a denominator of at most
+ * SOLVE_DENOMINATOR_LIMIT, found from the convergents of its continued
+ * fraction, so that a solution such as 1/3 comes back exactly.
+ */
+static Fraction to_fraction(double x) {
+  double rest = fabs(x);
+  long long previous_numerator = 0;
+  long long previous_denominator = 1;
+  long long numerator = 1;
+  long long denominator = 0;
+
+  if (!(rest < INT_MAX)) {
+    return Fraction (x < 0 ? -INT_MAX : INT_MAX);
+  }
+
+  for (int step = 0; step < 64; step++) {
+    double whole = floor(rest);
+    long long next_numerator = (long long) whole * numerator + previous_numerator;
+    long long next_denominator = (long long) whole * denominator + previous_denominator;
+
+    if (next_denominator > SOLVE_DENOMINATOR_LIMIT || next_numerator > INT_MAX) {
+      break;
+    }
+
+    previous_numerator = numerator;
+    previous_denominator = denominator;
+    numerator = next_numerator;
+    denominator = next_denominator;
+
+    if (rest - whole < 1e-12 || fabs(fabs(x) - (double) numerator / denominator) <= 1e-15 * fabs(x)) {
+      break;
+    }
+
+    rest = 1.0 / (rest - whole);
+  }
+
+  if (denominator == 0) {
+    return Fraction ();
+  }
+
+  return Fraction ((int) (x < 0 ? -numerator : numerator), (int) denominator);
+}
+
+/**
+ * Converts the compressed form of a matrix to doubles.
+ */
+static void convert(const struct csr_matrix *a, struct csr_double *m) {
+  m->n = a->rows;
+  m->row_start = a->row_start;
+  m->column_index = a->column_index;
+  m->values.resize(a->values.size());
+
+  for (size_t i = 0; i < a->values.size(); i++) {
+    m->values[i] = to_double(a->values[i]);
+  }
+}
+
+/**
+ * Computes y = Ax.
+ */
+static void multiply_vector(const struct csr_double &a, const vector<double> &x, vector<double> &y) {
+  for (int i = 0; i < a.n; i++) {
+    double sum = 0.0;
+
+    for (int k = a.row_start[i]; k < a.row_start[i + 1]; k++) {
+      sum += a.values[k] * x[a.column_index[k]];
+    }
+
+    y[i] = sum;
+  }
+}
+
+static double dot(const vector<double> &x, const vector<double> &y) {
+  double sum = 0.0;
+
+  for (size_t i = 0; i < x.size(); i++) {
+    sum += x[i] * y[i];
+  }
+
+  return sum;
+}
+
+static double norm(const vector<double> &x) {
+  return sqrt(dot(x, x));
+}
+
+/**
+ * Factorises the matrix incompletely into LU, keeping only the elements in
+ * the non-zero pattern of the matrix. Returns false if a diagonal element is
+ * missing or becomes zero on the way.
+ */
+static bool factorise_incomplete(const struct csr_double &a, struct preconditioner_state *m) {
+  struct csr_double &f = m->factors;
+  vector<int> position(a.n, -1);
+
+  f = a;
+  m->diagonal.assign(a.n, -1);
+
+  for (int i = 0; i < a.n; i++) {
+    for (int k = f.row_start[i]; k < f.row_start[i + 1]; k++) {
+      position[f.column_index[k]] = k;
+
+      if (f.column_index[k] == i) {
+        m->diagonal[i] = k;
+      }
+    }
+
+    // The columns of a row are ordered, so the rows above are eliminated in
+    // turn and each only updates the elements already in the pattern.
+    for (int k = f.row_start[i]; k < f.row_start[i + 1] && f.column_index[k] < i; k++) {
+      int q = f.column_index[k];
+
+      f.values[k] /= f.values[m->diagonal[q]];
+
+      for (int t = m->diagonal[q] + 1; t < f.row_start[q + 1]; t++) {
+        if (position[f.column_index[t]] >= 0) {
+          f.values[position[f.column_index[t]]] -= f.values[k] * f.values[t];
+        }
+      }
+    }
+
+    for (int k = f.row_start[i]; k < f.row_start[i + 1]; k++) {
+      position[f.column_index[k]] = -1;
+    }
+
+    if (m->diagonal[i] < 0 || f.values[m->diagonal[i]] == 0.0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Sets up the requested preconditioner for the matrix. An ILU(0) which breaks
+ * down is replaced by the Jacobi preconditioner and a zero on the diagonal is
+ * left unscaled by the latter.
+ */
+static void setup_preconditioner(const struct csr_double &a, enum preconditioner kind, struct preconditioner_state *m) {
+  m->kind = kind;
+
+  if (kind == PRECONDITION_ILU0 && !factorise_incomplete(a, m)) {
+    m->kind = PRECONDITION_JACOBI;
+  }
+
+  if (m->kind == PRECONDITION_JACOBI) {
+    m->inverse_diagonal.assign(a.n, 1.0);
+
+    for (int i = 0; i < a.n; i++) {
+      for (int k = a.row_start[i]; k < a.row_start[i + 1]; k++) {
+        if (a.column_index[k] == i && a.values[k] != 0.0) {
+          m->inverse_diagonal[i] = 1.0 / a.values[k];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Computes z = M^-1 r.
+ */
+static void precondition(const struct preconditioner_state &m, const vector<double> &r, vector<double> &z) {
+  switch (m.kind) {
+    case PRECONDITION_JACOBI:
+      for (size_t i = 0; i < r.size(); i++) {
+        z[i] = m.inverse_diagonal[i] * r[i];
+      }
+      break;
+    case PRECONDITION_ILU0: {
+      const struct csr_double &f = m.factors;
+
+      // Solves Ly = r with the unit lower factor and then Uz = y.
+      for (int i = 0; i < f.n; i++) {
+        double sum = r[i];
+
+        for (int k = f.row_start[i]; k < m.diagonal[i]; k++) {
+          sum -= f.values[k] * z[f.column_index[k]];
+        }
+
+        z[i] = sum;
+      }
+
+      for (int i = f.n - 1; i >= 0; i--) {
+        double sum = z[i];
+
+        for (int k = m.diagonal[i] + 1; k < f.row_start[i + 1]; k++) {
+          sum -= f.values[k] * z[f.column_index[k]];
+        }
+
+        z[i] = sum / f.values[m.diagonal[i]];
+      }
+      break;
+    }
+    default:
+      z = r;
+      break;
+  }
+}
+
+/**
+ * Solves Ax = b by preconditioned conjugate gradients, starting from zero.
+ * Returns the number of iterations taken.
+ */
+static int conjugate_gradients(const struct csr_double &a, const struct preconditioner_state &m,
+                               const vector<double> &b, vector<double> &x) {
+  int n = a.n;
+  vector<double> r = b;
+  vector<double> z(n);
+  vector<double> p(n);
+  vector<double> ap(n);
+  double limit = SOLVE_TOLERANCE * norm(b);
+
+  x.assign(n, 0.0);
+  precondition(m, r, z);
+  p = z;
+
+  double rz = dot(r, z);
+  int iterations = 0;
+
+  while (norm(r) > limit && iterations < SOLVE_MAX_ITERATIONS) {
+    multiply_vector(a, p, ap);
+
+    double curvature = dot(p, ap);
+
+    // The matrix is not positive definite along p, so the method breaks down.
+    if (curvature <= 0.0) {
+      break;
+    }
+
+    double alpha = rz / curvature;
+
+    for (int i = 0; i < n; i++) {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * ap[i];
+    }
+
+    precondition(m, r, z);
+
+    double next = dot(r, z);
+
+    for (int i = 0; i < n; i++) {
+      p[i] = z[i] + next / rz * p[i];
+    }
+
+    rz = next;
+    iterations++;
+  }
+
+  return iterations;
+}
+
+/**
+ * Solves Ax = b by restarted GMRES, preconditioned from the right so that the
+ * residual it minimises is that of the original system, starting from zero.
+ * Returns the number of iterations taken.
+ */
+static int gmres(const struct csr_double &a, const struct preconditioner_state &m,
+                 const vector<double> &b, vector<double> &x) {
+  int n = a.n;
+  double limit = SOLVE_TOLERANCE * norm(b);
+  vector<vector<double> > v(GMRES_RESTART + 1, vector<double>(n));
+  vector<vector<double> > h(GMRES_RESTART + 1, vector<double>(GMRES_RESTART));
+  vector<double> cosines(GMRES_RESTART);
+  vector<double> sines(GMRES_RESTART);
+  vector<double> g(GMRES_RESTART + 1);
+  vector<double> r(n);
+  vector<double> z(n);
+  int iterations = 0;
+
+  x.assign(n, 0.0);
+
+  while (iterations < SOLVE_MAX_ITERATIONS) {
+    multiply_vector(a, x, r);
+
+    for (int i = 0; i < n; i++) {
+      r[i] = b[i] - r[i];
+    }
+
+    double beta = norm(r);
+
+    if (beta <= limit) {
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      v[0][i] = r[i] / beta;
+    }
+
+    g.assign(GMRES_RESTART + 1, 0.0);
+    g[0] = beta;
+
+    int j = 0;
+
+    while (j < GMRES_RESTART && iterations < SOLVE_MAX_ITERATIONS) {
+      precondition(m, v[j], z);
+      multiply_vector(a, z, v[j + 1]);
+
+      // Arnoldi step: v[j + 1] is orthogonalised against the earlier vectors.
+      for (int i = 0; i <= j; i++) {
+        h[i][j] = dot(v[j + 1], v[i]);
+
+        for (int q = 0; q < n; q++) {
+          v[j + 1][q] -= h[i][j] * v[i][q];
+        }
+      }
+
+      h[j + 1][j] = norm(v[j + 1]);
+
+      if (h[j + 1][j] != 0.0) {
+        for (int q = 0; q < n; q++) {
+          v[j + 1][q] /= h[j + 1][j];
+        }
+      }
+
+      // The Hessenberg matrix is kept upper triangular by Givens rotations,
+      // which also give the residual of the least squares problem.
+      for (int i = 0; i < j; i++) {
+        double upper = cosines[i] * h[i][j] + sines[i] * h[i + 1][j];
+        h[i + 1][j] = -sines[i] * h[i][j] + cosines[i] * h[i + 1][j];
+        h[i][j] = upper;
+      }
+
+      double radius = hypot(h[j][j], h[j + 1][j]);
+
+      cosines[j] = radius == 0.0 ? 1.0 : h[j][j] / radius;
+      sines[j] = radius == 0.0 ? 0.0 : h[j + 1][j] / radius;
+      h[j][j] = radius;
+      h[j + 1][j] = 0.0;
+      g[j + 1] = -sines[j] * g[j];
+      g[j] = cosines[j] * g[j];
+
+      j++;
+      iterations++;
+
+      if (fabs(g[j]) <= limit || radius == 0.0) {
+        break;
+      }
+    }
+
+    // Solves the triangular least squares system and updates x by the
+    // preconditioned combination of the basis vectors.
+    vector<double> y(j);
+
+    for (int i = j - 1; i >= 0; i--) {
+      double sum = g[i];
+
+      for (int q = i + 1; q < j; q++) {
+        sum -= h[i][q] * y[q];
+      }
+
+      y[i] = h[i][i] == 0.0 ? 0.0 : sum / h[i][i];
+    }
+
+    fill(r.begin(), r.end(), 0.0);
+
+    for (int i = 0; i < j; i++) {
+      for (int q = 0; q < n; q++) {
+        r[q] += y[i] * v[i][q];
+      }
+    }
+
+    precondition(m, r, z);
+
+    for (int q = 0; q < n; q++) {
+      x[q] += z[q];
+    }
+
+    if (fabs(g[j]) <= limit || h[j - 1][j - 1] == 0.0) {
+      break;
+    }
+  }
+
+  return iterations;
+}
+
+/**
+ * Solves AX = B iteratively, column by column of B, and records the
+ * iterations and the residual in the statistics. Returns a null pointer and
+ * alerts the user if the method does not converge.
+ */
+static Matrix* solve_iterative(Matrix *a, Matrix *b, enum solve_method method) {
+  int n = a->get_rows();
+  int k = b->get_columns();
+  struct csr_double m;
+  struct preconditioner_state p;
+
+  convert(csr_of(a).get(), &m);
+  setup_preconditioner(m, solve_get_preconditioner(), &p);
+
+  Matrix *x = new Matrix(n, k);
+  vector<double> column(n);
+  vector<double> solution(n);
+  vector<double> product(n);
+  unsigned long iterations = 0;
+  double residual = 0.0;
+
+  for (int j = 0; j < k; j++) {
+    for (int i = 0; i < n; i++) {
+      column[i] = to_double(b->elements[i * k + j]);
+    }
+
+    if (method == SOLVE_CG) {
+      iterations += conjugate_gradients(m, p, column, solution);
+    } else {
+      iterations += gmres(m, p, column, solution);
+    }
+
+    // The residual is measured again, as the one updated by the methods
+    // drifts from the true one through rounding.
+    multiply_vector(m, solution, product);
+
+    for (int i = 0; i < n; i++) {
+      product[i] -= column[i];
+      x->elements[i * k + j] = to_fraction(solution[i]);
+    }
+
+    double size = norm(column);
+
+    if (size > 0.0) {
+      residual = max(residual, norm(product) / size);
+    }
+  }
+
+  {
+    lock_guard<mutex> guard(statistics_lock);
+
+    statistics.solves++;
+    statistics.iterations += iterations;
+    statistics.residual = max(statistics.residual, residual);
+  }
+
+  if (!(residual <= sqrt(SOLVE_TOLERANCE))) {
+    delete x;
+    report_error("The iterative solver did not converge!");
+    return nullptr;
+  }
+
+  return x;
+}
+
+/**
+ * Solves AX = B for X with the chosen method. Returns a null pointer and
+ * alerts the user if A is not square, its dimensions do not match those of B,
+ * it is singular or the chosen iterative method cannot solve the system.
+ */
+Matrix* solve(Matrix *a, Matrix *b) {
+  if (a->get_rows() != a->get_columns() || a->get_rows() != b->get_rows()) {
+    report_error("The matrices' dimensions do not match!");
+    return nullptr;
+  }
+
+  enum solve_method method = solve_get_method();
+
+  if (method == SOLVE_CG && !(structure_of(a).flags & STRUCTURE_SYMMETRIC)) {
+    report_error("Conjugate gradients need a symmetric matrix!");
+    return nullptr;
+  }
+
+  if (method == SOLVE_CG || method == SOLVE_GMRES) {
+    return solve_iterative(a, b, method);
+  }
+
+  Matrix *x = nullptr;
+
+  if (method == SOLVE_REFINED) {
+    unsigned long steps = 0;
+
+    x = refine_solve(a, b, &steps);
+
+    lock_guard<mutex> guard(statistics_lock);
+
+    statistics.solves++;
+    statistics.iterations += steps;
+    statistics.fallbacks += x == nullptr;
+  }
+
+  if (x == nullptr) {
+    x = lu_solve(lu_factorise(a).get(), b);
+  }
+
+  if (x == nullptr) {
+    report_error("The matrix is singular!");
+  }
+
+  return x;
+}
+
+/**
+ * Returns the inverse of the passed in matrix by solving AX = I with the
+ * chosen method. Returns a null pointer and alerts the user if the matrix is
+ * not square or is singular.
+ */
+Matrix* solve_inverse(Matrix *a) {
+  if (a->get_rows() != a->get_columns()) {
+    report_error("The matrices' dimensions do not match!");
+    return nullptr;
+  }
+
+  Matrix *identity = identity_matrix(a->get_rows(), a->get_columns());
+  Matrix *inverse = solve(a, identity);
+
+  delete identity;
+
+  return inverse;
+}
@@ -0,0 +1,86 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __SOLVER_H_INCLUDED__
+#define __SOLVER_H_INCLUDED__
+
+#include "matrix.h"
+
+/**
+ * The relative residual below which an iterative solve has converged.
+ */
+#define SOLVE_TOLERANCE 1e-10
+
+/**
+ * The largest number of iterations an iterative solve takes for a single
+ * column of the right hand side before giving up.
+ */
+#define SOLVE_MAX_ITERATIONS 10000
+
+/**
+ * The number of iterations after which GMRES restarts, which bounds the
+ * number of vectors it keeps.
+ */
+#define GMRES_RESTART 30
+
+/**
+ * The largest denominator of the fractions the solutions of the iterative
+ * methods are rounded to.
+ */
+#define SOLVE_DENOMINATOR_LIMIT 1000000
+
+/**
+ * Enumeration of the ways AX = B is solved. The direct method solves it
+ * exactly with the LU factorisation of A and the refined one exactly by
+ * iterative refinement of a double precision factorisation, which is also used
+ * for inverses. Conjugate gradients (for symmetric positive definite A) and
+ * GMRES iterate in double precision over the non-zero elements of A only.
+ */
+enum solve_method {SOLVE_DIRECT, SOLVE_REFINED, SOLVE_CG, SOLVE_GMRES};
+
+/**
+ * Enumeration of the preconditioners applied by the iterative methods.
+ */
+enum preconditioner {PRECONDITION_NONE, PRECONDITION_JACOBI, PRECONDITION_ILU0};
+
+/**
+ * The number of iterative or refined solves carried out, the iterations or
+ * refinement steps they took over all the columns of their right hand sides,
+ * the largest relative residual any iterative one ended with and the number
+ * of refined ones which had to be solved exactly instead.
+ */
+struct solve_statistics {
+  unsigned long solves;
+  unsigned long iterations;
+  double residual;
+  unsigned long fallbacks;
+};
+
+void solve_set_method(enum solve_method method, enum preconditioner preconditioner);
+enum solve_method solve_get_method(void);
+enum preconditioner solve_get_preconditioner(void);
+const char* solve_method_name(enum solve_method method);
+const char* preconditioner_name(enum preconditioner preconditioner);
+struct solve_statistics solve_take_statistics(void);
+Matrix* solve(Matrix *a, Matrix *b);
+Matrix* solve_inverse(Matrix *a);
+
+#endif
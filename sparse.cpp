@@ -0,0 +1,345 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "operations.h"
+#include "sparse.h"
+#include "sparse_lu.h"
+
+using namespace std;
+
+/**
+ * The compressed form kept for a version of a matrix and, once it has been
+ * asked for, its sparse factorisation.
+ */
+struct csr_entry {
+  unsigned long version;
+  shared_ptr<const struct csr_matrix> form;
+  shared_ptr<const struct sparse_lu> factors;
+};
+
+/**
+ * The compressed forms kept for the matrices by their ids. The store is never
+ * freed, as matrices may still be destroyed while the program exits.
+ */
+struct csr_store {
+  unordered_map<unsigned long, struct csr_entry> entries;
+  mutex lock;
+};
+
+static struct csr_store *store = new csr_store;
+
+/**
+ * Builds the compressed form of the passed in matrix.
+ */
+static struct csr_matrix* compress(Matrix *a) {
+  struct csr_matrix *m = new csr_matrix;
+  int columns = a->get_columns();
+
+  m->rows = a->get_rows();
+  m->columns = columns;
+  m->row_start.push_back(0);
+
+  for (int i = 0; i < m->rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      if (!is_zero(a->elements[i * columns + j])) {
+        m->column_index.push_back(j);
+        m->values.push_back(a->elements[i * columns + j]);
+      }
+    }
+
+    m->row_start.push_back(m->values.size());
+  }
+
+  return m;
+}
+
+/**
+ * Keeps the passed in compressed form for the current version of the passed
+ * in matrix.
+ */
+static void keep(Matrix *a, const shared_ptr<const struct csr_matrix> &form) {
+  lock_guard<mutex> guard(store->lock);
+
+  store->entries[a->id] = {a->version, form, nullptr};
+  a->stored |= STORED_SPARSE;
+}
+
+/**
+ * Returns the compressed form of the current version of the passed in matrix,
+ * building it only if it has not been kept already.
+ */
+shared_ptr<const struct csr_matrix> csr_of(Matrix *a) {
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    unordered_map<unsigned long, struct csr_entry>::iterator found = store->entries.find(a->id);
+
+    if (found != store->entries.end() && found->second.version == a->version) {
+      return found->second.form;
+    }
+  }
+
+  shared_ptr<const struct csr_matrix> form(compress(a));
+
+  keep(a, form);
+
+  return form;
+}
+
+/**
+ * Returns the sparse factorisation of the current version of the passed in
+ * matrix, computing it only if it has not been kept already.
+ */
+shared_ptr<const struct sparse_lu> sparse_factorise(Matrix *a) {
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    unordered_map<unsigned long, struct csr_entry>::iterator found = store->entries.find(a->id);
+
+    if (found != store->entries.end() && found->second.version == a->version
+        && found->second.factors != nullptr) {
+      return found->second.factors;
+    }
+  }
+
+  shared_ptr<const struct sparse_lu> factors(sparse_eliminate(csr_of(a).get(), false));
+
+  lock_guard<mutex> guard(store->lock);
+
+  unordered_map<unsigned long, struct csr_entry>::iterator found = store->entries.find(a->id);
+
+  if (found != store->entries.end() && found->second.version == a->version) {
+    found->second.factors = factors;
+  }
+
+  return factors;
+}
+
+/**
+ * Drops the compressed form and factorisation kept for the passed in matrix,
+ * which is being destroyed.
+ */
+void sparse_forget(Matrix *a) {
+  struct csr_entry old;
+
+  lock_guard<mutex> guard(store->lock);
+
+  unordered_map<unsigned long, struct csr_entry>::iterator found = store->entries.find(a->id);
+
+  if (found != store->entries.end()) {
+    old = std::move(found->second);
+    store->entries.erase(found);
+  }
+}
+
+/**
+ * Checks whether few enough elements of the compressed matrix are non-zero for
+ * the sparse kernels to pay off.
+ */
+bool is_sparse(const struct csr_matrix *m) {
+  return m->values.size() <= SPARSE_DENSITY * m->rows * m->columns;
+}
+
+/**
+ * Checks whether few enough elements of the passed in matrix are non-zero for
+ * the sparse kernels to pay off. The compressed form is used if it is kept.
+ * Otherwise the non-zero elements are counted only until there are too many,
+ * so that a dense matrix is neither compressed nor scanned in full.
+ */
+bool is_sparse_matrix(Matrix *a) {
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    unordered_map<unsigned long, struct csr_entry>::iterator found = store->entries.find(a->id);
+
+    if (found != store->entries.end() && found->second.version == a->version) {
+      return is_sparse(found->second.form.get());
+    }
+  }
+
+  long size = (long) a->get_rows() * a->get_columns();
+  long limit = (long) (SPARSE_DENSITY * size);
+  long non_zeros = 0;
+
+  for (long i = 0; i < size; i++) {
+    if (!is_zero(a->elements[i]) && ++non_zeros > limit) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Returns a newly allocated dense copy of the compressed matrix. The
+ * compressed form is kept for the copy, so that further sparse operations on
+ * it do not have to build it again.
+ */
+Matrix* csr_to_dense(const shared_ptr<const struct csr_matrix> &m) {
+  Matrix *a = new Matrix(m->rows, m->columns);
+
+  for (int i = 0; i < m->rows; i++) {
+    for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+      a->elements[i * m->columns + m->column_index[k]] = m->values[k];
+    }
+  }
+
+  keep(a, m);
+
+  return a;
+}
+
+/**
+ * Returns the sum or, if subtract is set, the difference of two compressed
+ * matrices with the same dimensions. The rows are merged by column, so only
+ * the non-zero elements are visited.
+ */
+struct csr_matrix* csr_add(const struct csr_matrix *a, const struct csr_matrix *b, bool subtract) {
+  struct csr_matrix *c = new csr_matrix;
+
+  c->rows = a->rows;
+  c->columns = a->columns;
+  c->row_start.push_back(0);
+
+  for (int i = 0; i < a->rows; i++) {
+    int p = a->row_start[i];
+    int q = b->row_start[i];
+
+    while (p < a->row_start[i + 1] || q < b->row_start[i + 1]) {
+      int column;
+      Fraction value;
+
+      if (q == b->row_start[i + 1]
+          || (p < a->row_start[i + 1] && a->column_index[p] < b->column_index[q])) {
+        column = a->column_index[p];
+        value = a->values[p++];
+      } else if (p == a->row_start[i + 1] || b->column_index[q] < a->column_index[p]) {
+        column = b->column_index[q];
+        value = subtract ? -b->values[q] : b->values[q];
+        q++;
+      } else {
+        column = a->column_index[p];
+        value = subtract ? a->values[p] - b->values[q] : a->values[p] + b->values[q];
+        p++;
+        q++;
+      }
+
+      if (!is_zero(value)) {
+        c->column_index.push_back(column);
+        c->values.push_back(value);
+      }
+    }
+
+    c->row_start.push_back(c->values.size());
+  }
+
+  return c;
+}
+
+/**
+ * Returns the product of two compressed matrices whose dimensions match, row
+ * by row (Gustavson's algorithm). Each non-zero element a[i][k] adds a multiple
+ * of row k of b to an accumulator for row i of the product, which only keeps
+ * track of the columns it touched.
+ */
+struct csr_matrix* csr_multiply(const struct csr_matrix *a, const struct csr_matrix *b) {
+  struct csr_matrix *c = new csr_matrix;
+  vector<Fraction> accumulator(b->columns);
+  vector<int> touched_in(b->columns, -1);
+  vector<int> touched;
+
+  c->rows = a->rows;
+  c->columns = b->columns;
+  c->row_start.push_back(0);
+
+  for (int i = 0; i < a->rows; i++) {
+    touched.clear();
+
+    for (int p = a->row_start[i]; p < a->row_start[i + 1]; p++) {
+      int k = a->column_index[p];
+      Fraction aik = a->values[p];
+
+      for (int q = b->row_start[k]; q < b->row_start[k + 1]; q++) {
+        int j = b->column_index[q];
+
+        if (touched_in[j] != i) {
+          touched_in[j] = i;
+          touched.push_back(j);
+          accumulator[j] = aik * b->values[q];
+        } else {
+          accumulator[j] += aik * b->values[q];
+        }
+      }
+    }
+
+    sort(touched.begin(), touched.end());
+
+    for (size_t t = 0; t < touched.size(); t++) {
+      if (!is_zero(accumulator[touched[t]])) {
+        c->column_index.push_back(touched[t]);
+        c->values.push_back(accumulator[touched[t]]);
+      }
+    }
+
+    c->row_start.push_back(c->values.size());
+  }
+
+  return c;
+}
+
+/**
+ * Returns the transpose of a compressed matrix. The elements are counted per
+ * column first, so that each can be put straight into its place.
+ */
+struct csr_matrix* csr_transpose(const struct csr_matrix *a) {
+  struct csr_matrix *c = new csr_matrix;
+
+  c->rows = a->columns;
+  c->columns = a->rows;
+  c->row_start.assign(a->columns + 1, 0);
+  c->column_index.resize(a->values.size());
+  c->values.resize(a->values.size());
+
+  for (size_t p = 0; p < a->column_index.size(); p++) {
+    c->row_start[a->column_index[p] + 1]++;
+  }
+
+  for (int j = 0; j < a->columns; j++) {
+    c->row_start[j + 1] += c->row_start[j];
+  }
+
+  vector<int> next(c->row_start.begin(), c->row_start.end() - 1);
+
+  for (int i = 0; i < a->rows; i++) {
+    for (int p = a->row_start[i]; p < a->row_start[i + 1]; p++) {
+      int position = next[a->column_index[p]]++;
+
+      c->column_index[position] = i;
+      c->values[position] = a->values[p];
+    }
+  }
+
+  return c;
+}
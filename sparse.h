@@ -0,0 +1,60 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __SPARSE_H_INCLUDED__
+#define __SPARSE_H_INCLUDED__
+
+#include <memory>
+#include <vector>
+#include "matrix.h"
+
+/**
+ * The largest share of non-zero elements for which a matrix is treated as
+ * sparse by the evaluator.
+ */
+#define SPARSE_DENSITY 0.1
+
+/**
+ * A matrix in compressed sparse row form. The non-zero elements of row i are
+ * values[row_start[i]] to values[row_start[i + 1] - 1], ordered by their
+ * columns, which are kept in column_index.
+ */
+struct csr_matrix {
+  int rows;
+  int columns;
+  std::vector<int> row_start;
+  std::vector<int> column_index;
+  std::vector<Fraction> values;
+};
+
+struct sparse_lu;
+
+std::shared_ptr<const struct csr_matrix> csr_of(Matrix *a);
+std::shared_ptr<const struct sparse_lu> sparse_factorise(Matrix *a);
+void sparse_forget(Matrix *a);
+bool is_sparse(const struct csr_matrix *m);
+bool is_sparse_matrix(Matrix *a);
+Matrix* csr_to_dense(const std::shared_ptr<const struct csr_matrix> &m);
+struct csr_matrix* csr_add(const struct csr_matrix *a, const struct csr_matrix *b, bool subtract);
+struct csr_matrix* csr_multiply(const struct csr_matrix *a, const struct csr_matrix *b);
+struct csr_matrix* csr_transpose(const struct csr_matrix *a);
+
+#endif
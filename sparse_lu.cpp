@@ -0,0 +1,382 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include "operations.h"
+#include "sparse_lu.h"
+
+using namespace std;
+
+/**
+ * Returns the position of the element in the passed in column of a sorted
+ * sparse row, or -1 if the element is zero.
+ */
+static int find_entry(const vector<struct sparse_entry> &row, int column) {
+  int low = 0;
+  int high = row.size();
+
+  while (low < high) {
+    int middle = (low + high) / 2;
+
+    if (row[middle].index < column) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low < (int) row.size() && row[low].index == column ? low : -1;
+}
+
+/**
+ * Returns the sign of the permutation which takes position k to order[k].
+ */
+static int permutation_sign(const vector<int> &order) {
+  vector<bool> visited(order.size(), false);
+  int sign = 1;
+
+  for (size_t start = 0; start < order.size(); start++) {
+    if (visited[start]) {
+      continue;
+    }
+
+    size_t length = 0;
+
+    for (size_t k = start; !visited[k]; k = order[k]) {
+      visited[k] = true;
+      length++;
+    }
+
+    if (length % 2 == 0) {
+      sign = -sign;
+    }
+  }
+
+  return sign;
+}
+
+/**
+ * Eliminates a sparse matrix without ever storing its zeros. Each step picks
+ * the pivot with the lowest Markowitz cost (r - 1) * (c - 1), where r and c
+ * count the non-zero elements left in its row and column, among the
+ * SPARSE_SEARCH_COLUMNS columns with the fewest of them. Starting from the
+ * sparsest columns orders them to reduce the fill-in, as COLAMD does, and the
+ * counts are kept up to date as the elimination fills in or cancels elements.
+ * Ties go to the pivot with the smallest height. If echelon is set, the
+ * columns are taken from left to right instead, so that U is in row echelon
+ * form and only the rows are chosen by their counts.
+ */
+struct sparse_lu* sparse_eliminate(const struct csr_matrix *a, bool echelon) {
+  struct sparse_lu *f = new sparse_lu;
+  int rows = a->rows;
+  int columns = a->columns;
+  vector<vector<struct sparse_entry> > active(rows);
+  vector<vector<int> > column_rows(columns);
+  vector<int> count(columns, 0);
+  vector<bool> row_done(rows, false);
+  vector<bool> column_done(columns, false);
+  vector<int> seen(rows, -1);
+  Fraction product = Fraction (1);
+  int next_column = 0;
+
+  f->rows = rows;
+  f->columns = columns;
+  f->rank = 0;
+
+  for (int i = 0; i < rows; i++) {
+    for (int p = a->row_start[i]; p < a->row_start[i + 1]; p++) {
+      active[i].push_back({a->column_index[p], a->values[p]});
+      column_rows[a->column_index[p]].push_back(i);
+      count[a->column_index[p]]++;
+    }
+  }
+
+  while (f->rank < min(rows, columns)) {
+    int k = f->rank;
+    vector<int> candidates;
+
+    if (echelon) {
+      while (next_column < columns && count[next_column] == 0) {
+        next_column++;
+      }
+
+      if (next_column < columns) {
+        candidates.push_back(next_column);
+        next_column++;
+      }
+    } else {
+      for (int j = 0; j < columns; j++) {
+        if (column_done[j] || count[j] == 0) {
+          continue;
+        }
+
+        candidates.push_back(j);
+        sort(candidates.begin(), candidates.end(), [&count](int x, int y) { return count[x] < count[y]; });
+
+        if (candidates.size() > SPARSE_SEARCH_COLUMNS) {
+          candidates.pop_back();
+        }
+      }
+    }
+
+    // Every element left is zero, so the rank has been found.
+    if (candidates.empty()) {
+      break;
+    }
+
+    int pivot_row = -1;
+    int pivot_column = -1;
+    long best_cost = 0;
+    int best_height = 0;
+
+    for (int j : candidates) {
+      for (int i : column_rows[j]) {
+        if (row_done[i]) {
+          continue;
+        }
+
+        int position = find_entry(active[i], j);
+
+        if (position < 0) {
+          continue;
+        }
+
+        long cost = (long) (active[i].size() - 1) * (count[j] - 1);
+        int candidate_height = height(active[i][position].value);
+
+        if (pivot_row < 0 || cost < best_cost || (cost == best_cost && candidate_height < best_height)) {
+          pivot_row = i;
+          pivot_column = j;
+          best_cost = cost;
+          best_height = candidate_height;
+        }
+      }
+    }
+
+    vector<struct sparse_entry> pivot_entries;
+    pivot_entries.swap(active[pivot_row]);
+
+    Fraction pivot = pivot_entries[find_entry(pivot_entries, pivot_column)].value;
+
+    row_done[pivot_row] = true;
+    column_done[pivot_column] = true;
+
+    for (const struct sparse_entry &e : pivot_entries) {
+      count[e.index]--;
+    }
+
+    f->pivot_rows.push_back(pivot_row);
+    f->pivot_columns.push_back(pivot_column);
+    f->pivot_values.push_back(pivot);
+    f->lower.push_back(vector<struct sparse_entry>());
+    f->upper.push_back(vector<struct sparse_entry>());
+
+    for (const struct sparse_entry &e : pivot_entries) {
+      if (e.index != pivot_column) {
+        f->upper[k].push_back(e);
+      }
+    }
+
+    product *= pivot;
+
+    // Subtract a multiple of the pivot row from every other row with a
+    // non-zero element in the pivot column, merging the two by column.
+    for (int i : column_rows[pivot_column]) {
+      if (row_done[i] || seen[i] == k) {
+        continue;
+      }
+
+      seen[i] = k;
+
+      int position = find_entry(active[i], pivot_column);
+
+      if (position < 0) {
+        continue;
+      }
+
+      Fraction multiplier = active[i][position].value / pivot;
+      vector<struct sparse_entry> merged;
+      size_t p = 0;
+      size_t q = 0;
+
+      f->lower[k].push_back({i, multiplier});
+
+      while (p < active[i].size() || q < f->upper[k].size()) {
+        if (q == f->upper[k].size() || (p < active[i].size() && active[i][p].index < f->upper[k][q].index)) {
+          if (active[i][p].index == pivot_column) {
+            count[pivot_column]--;
+          } else {
+            merged.push_back(active[i][p]);
+          }
+          p++;
+        } else if (p == active[i].size() || f->upper[k][q].index < active[i][p].index) {
+          int column = f->upper[k][q].index;
+
+          merged.push_back({column, -(multiplier * f->upper[k][q].value)});
+          column_rows[column].push_back(i);
+          count[column]++;
+          q++;
+        } else {
+          Fraction value = active[i][p].value - multiplier * f->upper[k][q].value;
+
+          if (is_zero(value)) {
+            count[active[i][p].index]--;
+          } else {
+            merged.push_back({active[i][p].index, value});
+          }
+          p++;
+          q++;
+        }
+      }
+
+      active[i].swap(merged);
+    }
+
+    column_rows[pivot_column].clear();
+    f->rank++;
+  }
+
+  f->determinant = Fraction ();
+
+  if (rows == columns && f->rank == rows) {
+    f->determinant = product;
+
+    if (permutation_sign(f->pivot_rows) * permutation_sign(f->pivot_columns) < 0) {
+      f->determinant = -f->determinant;
+    }
+  }
+
+  return f;
+}
+
+/**
+ * Returns the inverse of the factorised matrix, one column at a time by
+ * forward and back substitution through the sparse factors, or a null pointer
+ * if the matrix is not square and invertible.
+ */
+Matrix* sparse_inverse(const struct sparse_lu *f) {
+  int n = f->rows;
+
+  if (f->rows != f->columns || f->rank < n) {
+    return nullptr;
+  }
+
+  Matrix *inverse = new Matrix(n, n);
+  vector<Fraction> y(n);
+  vector<Fraction> x(n);
+
+  for (int j = 0; j < n; j++) {
+    fill(y.begin(), y.end(), Fraction ());
+    y[j] = Fraction (1);
+
+    for (int k = 0; k < n; k++) {
+      Fraction value = y[f->pivot_rows[k]];
+
+      if (is_zero(value)) {
+        continue;
+      }
+
+      for (const struct sparse_entry &e : f->lower[k]) {
+        y[e.index] -= e.value * value;
+      }
+    }
+
+    for (int k = n - 1; k >= 0; k--) {
+      Fraction sum = y[f->pivot_rows[k]];
+
+      for (const struct sparse_entry &e : f->upper[k]) {
+        if (!is_zero(x[e.index])) {
+          sum -= e.value * x[e.index];
+        }
+      }
+
+      x[f->pivot_columns[k]] = sum / f->pivot_values[k];
+    }
+
+    for (int i = 0; i < n; i++) {
+      inverse->elements[i * n + j] = is_zero(x[i]) ? Fraction () : x[i];
+    }
+  }
+
+  return inverse;
+}
+
+/**
+ * Returns the reduced row echelon form of a matrix factorised with echelon
+ * set. The pivot rows are scaled so that their pivots become one and, from the
+ * last one to the first, each is subtracted from the rows above with a
+ * non-zero element in its pivot column.
+ */
+Matrix* sparse_reduced_row_echelon_form(const struct sparse_lu *f) {
+  vector<vector<struct sparse_entry> > reduced(f->rank);
+
+  for (int k = 0; k < f->rank; k++) {
+    reduced[k].push_back({f->pivot_columns[k], Fraction (1)});
+
+    for (const struct sparse_entry &e : f->upper[k]) {
+      reduced[k].push_back({e.index, e.value / f->pivot_values[k]});
+    }
+  }
+
+  for (int k = f->rank - 1; k >= 0; k--) {
+    for (int i = 0; i < k; i++) {
+      int position = find_entry(reduced[i], f->pivot_columns[k]);
+
+      if (position < 0) {
+        continue;
+      }
+
+      Fraction factor = reduced[i][position].value;
+      vector<struct sparse_entry> merged;
+      size_t p = 0;
+      size_t q = 0;
+
+      while (p < reduced[i].size() || q < reduced[k].size()) {
+        if (q == reduced[k].size() || (p < reduced[i].size() && reduced[i][p].index < reduced[k][q].index)) {
+          merged.push_back(reduced[i][p++]);
+        } else if (p == reduced[i].size() || reduced[k][q].index < reduced[i][p].index) {
+          merged.push_back({reduced[k][q].index, -(factor * reduced[k][q].value)});
+          q++;
+        } else {
+          Fraction value = reduced[i][p].value - factor * reduced[k][q].value;
+
+          if (!is_zero(value)) {
+            merged.push_back({reduced[i][p].index, value});
+          }
+          p++;
+          q++;
+        }
+      }
+
+      reduced[i].swap(merged);
+    }
+  }
+
+  Matrix *c = new Matrix(f->rows, f->columns);
+
+  for (int k = 0; k < f->rank; k++) {
+    for (const struct sparse_entry &e : reduced[k]) {
+      c->elements[k * f->columns + e.index] = e.value;
+    }
+  }
+
+  return c;
+}
@@ -0,0 +1,67 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __SPARSE_LU_H_INCLUDED__
+#define __SPARSE_LU_H_INCLUDED__
+
+#include <vector>
+#include "matrix.h"
+#include "sparse.h"
+
+/**
+ * The number of sparsest columns searched for the pivot of each step of the
+ * sparse elimination.
+ */
+#define SPARSE_SEARCH_COLUMNS 4
+
+/**
+ * A non-zero element of a sparse row or column, with the index of its column
+ * or row respectively.
+ */
+struct sparse_entry {
+  int index;
+  Fraction value;
+};
+
+/**
+ * The factorisation PAQ = LU of a sparse matrix, where P and Q order the rows
+ * and columns by the pivots chosen. The k-th pivot is in row pivot_rows[k] and
+ * column pivot_columns[k]. lower[k] holds the rows eliminated by it together
+ * with their multipliers and upper[k] the rest of its row, both by the indices
+ * of the matrix. Only non-zero elements are stored.
+ */
+struct sparse_lu {
+  int rows;
+  int columns;
+  std::vector<int> pivot_rows;
+  std::vector<int> pivot_columns;
+  std::vector<Fraction> pivot_values;
+  std::vector<std::vector<struct sparse_entry> > lower;
+  std::vector<std::vector<struct sparse_entry> > upper;
+  int rank;
+  Fraction determinant;
+};
+
+struct sparse_lu* sparse_eliminate(const struct csr_matrix *a, bool echelon);
+Matrix* sparse_inverse(const struct sparse_lu *f);
+Matrix* sparse_reduced_row_echelon_form(const struct sparse_lu *f);
+
+#endif
@@ -0,0 +1,388 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include "operations.h"
+#include "pool.h"
+#include "structure.h"
+
+using namespace std;
+
+/**
+ * The structure kept for a version of a matrix.
+ */
+struct structure_entry {
+  unsigned long version;
+  struct matrix_structure structure;
+};
+
+/**
+ * The structures kept for the matrices by their ids. The store is never freed,
+ * as matrices may still be destroyed while the program exits.
+ */
+struct structure_store {
+  unordered_map<unsigned long, struct structure_entry> entries;
+  mutex lock;
+};
+
+static struct structure_store *store = new structure_store;
+
+/**
+ * Finds the structure of the passed in matrix by visiting each of its elements
+ * once.
+ */
+static struct matrix_structure detect(Matrix *a) {
+  int rows = a->get_rows();
+  int columns = a->get_columns();
+  struct matrix_structure s = {0, 0, 0};
+  bool zero = true;
+  bool ones = true;
+  bool symmetric = rows == columns;
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      const Fraction &element = a->elements[i * columns + j];
+
+      if (symmetric && j < i && !(element == a->elements[j * columns + i])
+          && !(is_zero(element) && is_zero(a->elements[j * columns + i]))) {
+        symmetric = false;
+      }
+
+      if (i == j && !(element == Fraction (1))) {
+        ones = false;
+      }
+
+      if (is_zero(element)) {
+        continue;
+      }
+
+      zero = false;
+      s.lower_bandwidth = max(s.lower_bandwidth, i - j);
+      s.upper_bandwidth = max(s.upper_bandwidth, j - i);
+    }
+  }
+
+  if (zero) {
+    s.flags |= STRUCTURE_ZERO;
+  }
+
+  if (s.lower_bandwidth == 0) {
+    s.flags |= STRUCTURE_UPPER;
+  }
+
+  if (s.upper_bandwidth == 0) {
+    s.flags |= STRUCTURE_LOWER;
+  }
+
+  if (s.lower_bandwidth == 0 && s.upper_bandwidth == 0) {
+    s.flags |= STRUCTURE_DIAGONAL;
+
+    if (ones && rows == columns) {
+      s.flags |= STRUCTURE_IDENTITY;
+    }
+  }
+
+  if (symmetric) {
+    s.flags |= STRUCTURE_SYMMETRIC;
+  }
+
+  int band = s.lower_bandwidth + s.upper_bandwidth + 1;
+
+  if (band <= BANDED_WIDTH && band <= BANDED_SHARE * columns) {
+    s.flags |= STRUCTURE_BANDED;
+  }
+
+  return s;
+}
+
+/**
+ * Returns the structure of the current version of the passed in matrix,
+ * detecting it only if it has not been kept already. As every edit creates a
+ * new version, the structure is found again after the matrix changes.
+ */
+struct matrix_structure structure_of(Matrix *a) {
+  {
+    lock_guard<mutex> guard(store->lock);
+
+    unordered_map<unsigned long, struct structure_entry>::iterator found = store->entries.find(a->id);
+
+    if (found != store->entries.end() && found->second.version == a->version) {
+      return found->second.structure;
+    }
+  }
+
+  struct matrix_structure s = detect(a);
+
+  lock_guard<mutex> guard(store->lock);
+
+  store->entries[a->id] = {a->version, s};
+  a->stored |= STORED_STRUCTURE;
+
+  return s;
+}
+
+/**
+ * Drops the structure kept for the passed in matrix.
+ */
+void structure_forget(Matrix *a) {
+  lock_guard<mutex> guard(store->lock);
+
+  store->entries.erase(a->id);
+}
+
+/**
+ * Checks whether a matrix with the passed in structure has enough zeros in
+ * known places to be multiplied by structured_multiply.
+ */
+bool is_structured(const struct matrix_structure &s) {
+  return (s.flags & (STRUCTURE_ZERO | STRUCTURE_DIAGONAL | STRUCTURE_UPPER |
+                     STRUCTURE_LOWER | STRUCTURE_BANDED)) != 0;
+}
+
+/**
+ * Multiplies two matrices with matching dimensions, visiting only the elements
+ * within the bands of both of them, so that a product with a diagonal matrix
+ * takes one multiplication per element and one with a triangular matrix about
+ * half of the usual number. The square of a symmetric matrix is symmetric, so
+ * only its upper half is computed.
+ */
+Matrix* structured_multiply(Matrix *a, const struct matrix_structure &sa,
+                            Matrix *b, const struct matrix_structure &sb) {
+  int a_rows = a->get_rows();
+  int a_columns = a->get_columns();
+  int b_columns = b->get_columns();
+
+  Matrix *c = new Matrix(a_rows, b_columns);
+
+  if ((sa.flags & STRUCTURE_ZERO) || (sb.flags & STRUCTURE_ZERO)) {
+    return c;
+  }
+
+  bool square = a == b && (sa.flags & STRUCTURE_SYMMETRIC);
+  int width = sa.lower_bandwidth;
+
+  function<void(int, int)> body = [&](int from, int to) {
+    for (int i = from; i < to; i++) {
+      if (square) {
+        // The element in row i and column j is the product of the rows i and
+        // j, which only overlap within the band of both.
+        for (int j = i; j < min(b_columns, i + 2 * width + 1); j++) {
+          Fraction sum;
+
+          for (int k = max(0, j - width); k <= min(a_columns - 1, i + width); k++) {
+            sum += a->elements[i * a_columns + k] * a->elements[j * a_columns + k];
+          }
+
+          c->elements[i * b_columns + j] = sum;
+          c->elements[j * b_columns + i] = sum;
+        }
+        continue;
+      }
+
+      for (int k = max(0, i - sa.lower_bandwidth); k <= min(a_columns - 1, i + sa.upper_bandwidth); k++) {
+        Fraction aik = a->elements[i * a_columns + k];
+
+        if (is_zero(aik)) {
+          continue;
+        }
+
+        for (int j = max(0, k - sb.lower_bandwidth); j <= min(b_columns - 1, k + sb.upper_bandwidth); j++) {
+          c->elements[i * b_columns + j] += aik * b->elements[k * b_columns + j];
+        }
+      }
+    }
+  };
+
+  if (a_rows > BLOCK_SIZE) {
+    pool_parallel_for(shared_pool(), 0, a_rows, BLOCK_SIZE, body);
+  } else {
+    body(0, a_rows);
+  }
+
+  return c;
+}
+
+/**
+ * Returns the transpose of a symmetric matrix, which is a copy of it.
+ */
+Matrix* structured_transpose(Matrix *a) {
+  Matrix *c = new Matrix(a->get_rows(), a->get_columns());
+
+  copy(a->elements, a->elements + a->get_rows() * a->get_columns(), c->elements);
+
+  return c;
+}
+
+/**
+ * Returns the inverse of a square triangular matrix. A diagonal matrix only has
+ * its diagonal inverted, while any other triangular matrix is inverted column
+ * by column by substitution, as its inverse is triangular in the same way.
+ * Returns a null pointer and alerts the user if the matrix is singular, which
+ * is the case exactly when its diagonal has a zero.
+ */
+Matrix* structured_inverse(Matrix *a, const struct matrix_structure &s) {
+  int n = a->get_rows();
+
+  for (int i = 0; i < n; i++) {
+    if (is_zero(a->elements[i * n + i])) {
+      report_error("The matrix is singular!");
+      return nullptr;
+    }
+  }
+
+  Matrix *c = new Matrix(n, n);
+
+  for (int j = 0; j < n; j++) {
+    c->elements[j * n + j] = Fraction (1) / a->elements[j * n + j];
+  }
+
+  if (s.flags & STRUCTURE_DIAGONAL) {
+    return c;
+  }
+
+  bool upper = (s.flags & STRUCTURE_UPPER) != 0;
+
+  function<void(int, int)> body = [&](int from, int to) {
+    for (int j = from; j < to; j++) {
+      if (upper) {
+        for (int i = j - 1; i >= 0; i--) {
+          Fraction sum;
+
+          for (int k = i + 1; k <= j; k++) {
+            sum += a->elements[i * n + k] * c->elements[k * n + j];
+          }
+
+          c->elements[i * n + j] = -sum / a->elements[i * n + i];
+        }
+      } else {
+        for (int i = j + 1; i < n; i++) {
+          Fraction sum;
+
+          for (int k = j; k < i; k++) {
+            sum += a->elements[i * n + k] * c->elements[k * n + j];
+          }
+
+          c->elements[i * n + j] = -sum / a->elements[i * n + i];
+        }
+      }
+    }
+  };
+
+  if (n > BLOCK_SIZE) {
+    pool_parallel_for(shared_pool(), 0, n, 1, body);
+  } else {
+    body(0, n);
+  }
+
+  return c;
+}
+
+/**
+ * Returns the determinant of a square triangular matrix, the product of its
+ * diagonal.
+ */
+Fraction structured_determinant(Matrix *a) {
+  int n = a->get_rows();
+  Fraction det (1);
+
+  for (int i = 0; i < n && !is_zero(det); i++) {
+    det *= a->elements[i * n + i];
+  }
+
+  return det;
+}
+
+/**
+ * Returns the reduced row echelon form of a zero, diagonal or triangular matrix
+ * without eliminating it. The non-zero rows of a diagonal matrix only need to
+ * be scaled and moved up, while an upper triangular matrix with no zeros on its
+ * diagonal is reduced by back substitution and a square lower triangular one
+ * reduces to the identity. Returns a null pointer if the structure of the
+ * matrix does not allow any of these.
+ */
+Matrix* structured_reduced_row_echelon_form(Matrix *a, const struct matrix_structure &s) {
+  int rows = a->get_rows();
+  int columns = a->get_columns();
+  int diagonal = min(rows, columns);
+  bool full = true;
+
+  for (int i = 0; i < diagonal; i++) {
+    if (is_zero(a->elements[i * columns + i])) {
+      full = false;
+    }
+  }
+
+  if (s.flags & (STRUCTURE_ZERO | STRUCTURE_DIAGONAL)) {
+    Matrix *c = new Matrix(rows, columns);
+    int row = 0;
+
+    for (int i = 0; i < diagonal; i++) {
+      if (!is_zero(a->elements[i * columns + i])) {
+        c->elements[row++ * columns + i] = Fraction (1);
+      }
+    }
+
+    return c;
+  }
+
+  if (!full) {
+    return nullptr;
+  }
+
+  if ((s.flags & STRUCTURE_LOWER) && rows == columns) {
+    return identity_matrix(rows, columns);
+  }
+
+  if (!(s.flags & STRUCTURE_UPPER) || rows > columns) {
+    return nullptr;
+  }
+
+  Matrix *c = new Matrix(rows, columns);
+
+  copy(a->elements, a->elements + rows * columns, c->elements);
+
+  // Every row is scaled to a leading one and then cleared from the rows above
+  // it, from the last row up, so that each row only meets reduced rows below.
+  for (int i = rows - 1; i >= 0; i--) {
+    Fraction pivot = c->elements[i * columns + i];
+
+    for (int j = i; j < columns; j++) {
+      c->elements[i * columns + j] /= pivot;
+    }
+
+    for (int r = 0; r < i; r++) {
+      Fraction factor = c->elements[r * columns + i];
+
+      if (is_zero(factor)) {
+        continue;
+      }
+
+      for (int j = i; j < columns; j++) {
+        c->elements[r * columns + j] -= factor * c->elements[i * columns + j];
+      }
+    }
+  }
+
+  return c;
+}
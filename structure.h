@@ -0,0 +1,76 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __STRUCTURE_H_INCLUDED__
+#define __STRUCTURE_H_INCLUDED__
+
+#include "matrix.h"
+
+/**
+ * The most columns a matrix may span around its diagonal to be multiplied as a
+ * banded matrix. Wider bands are left to the blocked and sparse kernels, which
+ * beat visiting the band row by row long before it reaches a block.
+ */
+#define BANDED_WIDTH 8
+
+/**
+ * The largest share of the columns a banded matrix may span, so that a small
+ * matrix is not banded just because it is narrower than BANDED_WIDTH.
+ */
+#define BANDED_SHARE 0.5
+
+/**
+ * The structural properties a matrix can have. A matrix has every property
+ * implied by its others, so an identity matrix is also diagonal, upper and
+ * lower triangular and symmetric.
+ */
+enum structure_flag {
+  STRUCTURE_ZERO = 1,
+  STRUCTURE_IDENTITY = 2,
+  STRUCTURE_DIAGONAL = 4,
+  STRUCTURE_UPPER = 8,
+  STRUCTURE_LOWER = 16,
+  STRUCTURE_SYMMETRIC = 32,
+  STRUCTURE_BANDED = 64
+};
+
+/**
+ * The structure of a version of a matrix. Its non-zero elements lie at most
+ * lower_bandwidth rows below and upper_bandwidth columns to the right of the
+ * diagonal.
+ */
+struct matrix_structure {
+  unsigned flags;
+  int lower_bandwidth;
+  int upper_bandwidth;
+};
+
+struct matrix_structure structure_of(Matrix *a);
+void structure_forget(Matrix *a);
+bool is_structured(const struct matrix_structure &s);
+Matrix* structured_multiply(Matrix *a, const struct matrix_structure &sa,
+                            Matrix *b, const struct matrix_structure &sb);
+Matrix* structured_transpose(Matrix *a);
+Matrix* structured_inverse(Matrix *a, const struct matrix_structure &s);
+Fraction structured_determinant(Matrix *a);
+Matrix* structured_reduced_row_echelon_form(Matrix *a, const struct matrix_structure &s);
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#include <atomic>
+#include <random>
+#include <vector>
+#include "verify.h"
+
+using namespace std;
+
+/**
+ * An unsigned 128-bit integer, wide enough for the product of two residues.
+ */
+__extension__ typedef unsigned __int128 wide;
+
+/**
+ * The prime 2^61 - 1 modulo which the checks are carried out, so that the
+ * fractions never overflow and a wrong result is caught by all but a tiny
+ * share of the random vectors.
+ */
+static const unsigned long long PRIME = (1ULL << 61) - 1;
+
+/**
+ * Whether the results are checked and the statistics gathered since they were
+ * last taken.
+ */
+static atomic<bool> enabled(false);
+static atomic<unsigned long> checks(0);
+static atomic<unsigned long> failures(0);
+
+/**
+ * Sets whether products and inverses are checked from now on.
+ */
+void verify_set_enabled(bool enable) {
+  enabled = enable;
+}
+
+/**
+ * Returns whether products and inverses are checked.
+ */
+bool verify_get_enabled(void) {
+  return enabled;
+}
+
+/**
+ * Returns the statistics gathered since they were last taken and starts
+ * gathering them anew.
+ */
+struct verify_statistics verify_take_statistics(void) {
+  struct verify_statistics statistics;
+
+  statistics.checks = checks.exchange(0);
+  statistics.failures = failures.exchange(0);
+
+  return statistics;
+}
+
+static unsigned long long multiply_mod(unsigned long long a, unsigned long long b) {
+  wide product = (wide) a * b;
+  unsigned long long folded = (unsigned long long) (product & PRIME) + (unsigned long long) (product >> 61);
+
+  return folded >= PRIME ? folded - PRIME : folded;
+}
+
+static unsigned long long add_mod(unsigned long long a, unsigned long long b) {
+  unsigned long long sum = a + b;
+
+  return sum >= PRIME ? sum - PRIME : sum;
+}
+
+static unsigned long long power_mod(unsigned long long base, unsigned long long exponent) {
+  unsigned long long result = 1;
+
+  while (exponent > 0) {
+    if (exponent & 1) {
+      result = multiply_mod(result, base);
+    }
+
+    base = multiply_mod(base, base);
+    exponent >>= 1;
+  }
+
+  return result;
+}
+
+/**
+ * Maps the elements of a matrix to their residues modulo the prime. No
+ * denominator is a multiple of the prime, as they fit in an int.
+ */
+static void reduce(Matrix *a, vector<unsigned long long> &residues) {
+  int size = a->get_rows() * a->get_columns();
+
+  residues.resize(size);
+
+  for (int i = 0; i < size; i++) {
+    long long numerator = a->elements[i][0];
+    unsigned long long residue = numerator < 0 ? PRIME - (unsigned long long) -numerator : numerator;
+
+    if (a->elements[i][1] != 1) {
+      residue = multiply_mod(residue, power_mod(a->elements[i][1], PRIME - 2));
+    }
+
+    residues[i] = residue;
+  }
+}
+
+/**
+ * Computes y = Mx modulo the prime for a matrix with the passed in number of
+ * rows and columns.
+ */
+static void multiply_vector(const vector<unsigned long long> &m, int rows, int columns,
+                            const vector<unsigned long long> &x, vector<unsigned long long> &y) {
+  y.assign(rows, 0);
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < columns; j++) {
+      y[i] = add_mod(y[i], multiply_mod(m[i * columns + j], x[j]));
+    }
+  }
+}
+
+/**
+ * Fills a vector with residues chosen uniformly at random.
+ */
+static void random_vector(int size, vector<unsigned long long> &x) {
+  static thread_local mt19937_64 generator(random_device {}());
+  uniform_int_distribution<unsigned long long> distribution(0, PRIME - 1);
+
+  x.resize(size);
+
+  for (int i = 0; i < size; i++) {
+    x[i] = distribution(generator);
+  }
+}
+
+/**
+ * Records the outcome of a check in the statistics.
+ */
+static bool record(bool passed) {
+  checks++;
+
+  if (!passed) {
+    failures++;
+  }
+
+  return passed;
+}
+
+/**
+ * Checks that AB = C by Freivalds' test: for random vectors x, A(Bx) has to
+ * equal Cx, which takes O(n^2) operations per vector instead of the O(n^3) of
+ * another product. A correct C always passes, while a wrong one passes with a
+ * probability of at most 2^-60 per vector.
+ */
+bool freivalds_product(Matrix *a, Matrix *b, Matrix *c) {
+  int rows = a->get_rows();
+  int inner = a->get_columns();
+  int columns = b->get_columns();
+
+  if (b->get_rows() != inner || c->get_rows() != rows || c->get_columns() != columns) {
+    return record(false);
+  }
+
+  vector<unsigned long long> ra, rb, rc, x, bx, abx, cx;
+
+  reduce(a, ra);
+  reduce(b, rb);
+  reduce(c, rc);
+
+  for (int trial = 0; trial < VERIFY_TRIALS; trial++) {
+    random_vector(columns, x);
+    multiply_vector(rb, inner, columns, x, bx);
+    multiply_vector(ra, rows, inner, bx, abx);
+    multiply_vector(rc, rows, columns, x, cx);
+
+    if (abx != cx) {
+      return record(false);
+    }
+  }
+
+  return record(true);
+}
+
+/**
+ * Checks that X is the inverse of the square matrix A by Freivalds' test, as
+ * A(Xx) has to equal x for random vectors x.
+ */
+bool freivalds_inverse(Matrix *a, Matrix *x) {
+  int n = a->get_rows();
+
+  if (a->get_columns() != n || x->get_rows() != n || x->get_columns() != n) {
+    return record(false);
+  }
+
+  vector<unsigned long long> ra, rx, v, xv, axv;
+
+  reduce(a, ra);
+  reduce(x, rx);
+
+  for (int trial = 0; trial < VERIFY_TRIALS; trial++) {
+    random_vector(n, v);
+    multiply_vector(rx, n, n, v, xv);
+    multiply_vector(ra, n, n, xv, axv);
+
+    if (axv != v) {
+      return record(false);
+    }
+  }
+
+  return record(true);
+}
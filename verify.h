@@ -0,0 +1,47 @@
+/**
+ * MCalc is a matrix calculator which allows you to save matrices and evaluate
+ * expressions containing more than one operator.
+ * Copyright (C) 2016 Christo Lolov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ * Christo Lolov can be contacted by writing an e-mail to cl7815@imperial.ac.uk.
+ */
+
+#ifndef __VERIFY_H_INCLUDED__
+#define __VERIFY_H_INCLUDED__
+
+#include "matrix.h"
+
+/**
+ * The number of random vectors a result is checked with. A wrong result
+ * passes a single check with a probability of at most 2^-60.
+ */
+#define VERIFY_TRIALS 2
+
+/**
+ * The number of results checked and how many of them failed.
+ */
+struct verify_statistics {
+  unsigned long checks;
+  unsigned long failures;
+};
+
+void verify_set_enabled(bool enabled);
+bool verify_get_enabled(void);
+struct verify_statistics verify_take_statistics(void);
+bool freivalds_product(Matrix *a, Matrix *b, Matrix *c);
+bool freivalds_inverse(Matrix *a, Matrix *x);
+
+#endif